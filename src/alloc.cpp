@@ -0,0 +1,29 @@
+/**
+ * \file alloc.cpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ */
+#include "alloc.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace alloc {
+thread_local unsigned long allocations = 0;
+
+unsigned long count() { return allocations; }
+} // namespace alloc
+
+#ifdef NPFSMO_COUNT_ALLOCS
+void *operator new(std::size_t size) {
+  alloc::allocations++;
+  if (void *p = std::malloc(size == 0 ? 1 : size))
+    return p;
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+#endif
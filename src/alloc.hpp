@@ -0,0 +1,18 @@
+/**
+ * \file alloc.hpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ *
+ * Heap allocation counting. When compiled with NPFSMO_COUNT_ALLOCS the global `operator new` counts the allocations of each
+ * thread; otherwise the count stays zero.
+ */
+#pragma once
+
+namespace alloc {
+#ifdef NPFSMO_COUNT_ALLOCS
+constexpr bool counting = true;
+#else
+constexpr bool counting = false;
+#endif
+
+unsigned long count(); // number of allocations of the calling thread so far
+} // namespace alloc
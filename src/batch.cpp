@@ -0,0 +1,147 @@
+/**
+ * \file batch.cpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ */
+#include "batch.hpp"
+
+#include <algorithm>
+#include <cassert>
+using namespace std;
+
+#include "solution.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_X86
+#endif
+
+namespace {
+
+using Perms = const vector<Job> *const *;
+
+void batch_scalar(const Instance &I, Perms π, unsigned K, unsigned ke, pair<Time, Time> *r) {
+  vector<Time> C(I.m + 1);
+  for (unsigned l = 0; l != K; ++l) {
+    fill(C.begin(), C.end(), 0);
+    Time ms = 0, ft = 0;
+    for (unsigned k = 1; k != ke; ++k) {
+      Time Cj = 0;
+      for (auto [i, p] : I.operations((*π[l])[k]))
+        C[i] = Cj = max(C[i], Cj) + p;
+      ft += Cj;
+      ms = max(ms, Cj);
+    }
+    r[l] = {ms, ft};
+  }
+}
+
+#if defined(BATCH_X86)
+// Lanes hold the completion times of different permutations, `C` is stored machine by machine with 8 lanes per machine. Missing
+// operations (p=0) are masked out instead of branching. Incomplete groups repeat the last permutation.
+__attribute__((target("avx2"))) void batch_avx2(const Instance &I, Perms π, unsigned K, unsigned ke, pair<Time, Time> *r) {
+  const unsigned m = I.m, stride = I.n + 1;
+  const int *pm = reinterpret_cast<const int *>(I.pm.data());
+  vector<Time> C((m + 1) * 8);
+  alignas(32) int jobs[8];
+  alignas(32) Time ms[8], ft[8];
+  const __m256i zero = _mm256_setzero_si256();
+
+  for (unsigned g = 0; g < K; g += 8) {
+    fill(C.begin(), C.end(), 0);
+    __m256i vms = zero, vft = zero;
+    for (unsigned k = 1; k != ke; ++k) {
+      for (unsigned l = 0; l != 8; ++l)
+        jobs[l] = (*π[min(g + l, K - 1)])[k];
+      const __m256i vj = _mm256_load_si256(reinterpret_cast<const __m256i *>(jobs));
+      __m256i Cj = zero;
+      for (unsigned i = 1; i <= m; ++i) {
+        const __m256i p = _mm256_i32gather_epi32(pm + i * stride, vj, 4);
+        __m256i *Cip = reinterpret_cast<__m256i *>(&C[i * 8]);
+        const __m256i Ci = _mm256_loadu_si256(Cip);
+        const __m256i Cn = _mm256_add_epi32(_mm256_max_epu32(Ci, Cj), p);
+        const __m256i missing = _mm256_cmpeq_epi32(p, zero);
+        _mm256_storeu_si256(Cip, _mm256_blendv_epi8(Cn, Ci, missing));
+        Cj = _mm256_blendv_epi8(Cn, Cj, missing);
+      }
+      vft = _mm256_add_epi32(vft, Cj);
+      vms = _mm256_max_epu32(vms, Cj);
+    }
+    _mm256_store_si256(reinterpret_cast<__m256i *>(ms), vms);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(ft), vft);
+    for (unsigned l = 0; l != 8 && g + l != K; ++l)
+      r[g + l] = {ms[l], ft[l]};
+  }
+}
+
+// same with 4 lanes and without gathers
+__attribute__((target("sse4.1"))) void batch_sse41(const Instance &I, Perms π, unsigned K, unsigned ke, pair<Time, Time> *r) {
+  const unsigned m = I.m;
+  vector<Time> C((m + 1) * 4);
+  Job jobs[4];
+  alignas(16) Time ms[4], ft[4];
+  const __m128i zero = _mm_setzero_si128();
+
+  for (unsigned g = 0; g < K; g += 4) {
+    fill(C.begin(), C.end(), 0);
+    __m128i vms = zero, vft = zero;
+    for (unsigned k = 1; k != ke; ++k) {
+      for (unsigned l = 0; l != 4; ++l)
+        jobs[l] = (*π[min(g + l, K - 1)])[k];
+      __m128i Cj = zero;
+      for (unsigned i = 1; i <= m; ++i) {
+        const __m128i p = _mm_set_epi32(I.pm[i][jobs[3]], I.pm[i][jobs[2]], I.pm[i][jobs[1]], I.pm[i][jobs[0]]);
+        __m128i *Cip = reinterpret_cast<__m128i *>(&C[i * 4]);
+        const __m128i Ci = _mm_loadu_si128(Cip);
+        const __m128i Cn = _mm_add_epi32(_mm_max_epu32(Ci, Cj), p);
+        const __m128i missing = _mm_cmpeq_epi32(p, zero);
+        _mm_storeu_si128(Cip, _mm_blendv_epi8(Cn, Ci, missing));
+        Cj = _mm_blendv_epi8(Cn, Cj, missing);
+      }
+      vft = _mm_add_epi32(vft, Cj);
+      vms = _mm_max_epu32(vms, Cj);
+    }
+    _mm_store_si128(reinterpret_cast<__m128i *>(ms), vms);
+    _mm_store_si128(reinterpret_cast<__m128i *>(ft), vft);
+    for (unsigned l = 0; l != 4 && g + l != K; ++l)
+      r[g + l] = {ms[l], ft[l]};
+  }
+}
+#endif
+
+} // namespace
+
+void compute_ms_ft_batch(const Instance &I, const vector<const vector<Job> *> &π, unsigned ke, vector<pair<Time, Time>> &r) {
+  const unsigned K = π.size();
+  r.resize(K);
+  if (K == 0)
+    return;
+  assert(all_of(π.begin(), π.end(), [&](auto σ) { return σ->size() >= ke; }));
+#if defined(BATCH_X86)
+  static const int level = __builtin_cpu_supports("avx2") ? 2 : __builtin_cpu_supports("sse4.1") ? 1 : 0;
+  if (level == 2)
+    batch_avx2(I, π.data(), K, ke, r.data());
+  else if (level == 1)
+    batch_sse41(I, π.data(), K, ke, r.data());
+  else
+#endif
+    batch_scalar(I, π.data(), K, ke, r.data());
+
+#ifndef NDEBUG
+  // check the result, and the narrower vectorized path if supported, against the reference evaluation
+  PSolution P(I);
+  vector<pair<Time, Time>> ref(K);
+  for (unsigned l = 0; l != K; ++l) {
+    copy(π[l]->begin(), π[l]->begin() + ke, P.π.begin());
+    P.fbegin = ke;
+    ref[l] = P.compute_ms_ft_mo(I);
+  }
+  assert(r == ref);
+#if defined(BATCH_X86)
+  if (level == 2) {
+    vector<pair<Time, Time>> r4(K);
+    batch_sse41(I, π.data(), K, ke, r4.data());
+    assert(r4 == ref);
+  }
+#endif
+#endif
+}
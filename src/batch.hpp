@@ -0,0 +1,15 @@
+/**
+ * \file batch.hpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ *
+ * Batch evaluation of permutations.
+ */
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "instance.hpp"
+
+// makespan and flowtime of the permutations `π` over positions 1..ke-1; vectorized over the permutations if the CPU supports it
+void compute_ms_ft_batch(const Instance &I, const std::vector<const std::vector<Job> *> &π, unsigned ke, std::vector<std::pair<Time, Time>> &r);
@@ -0,0 +1,203 @@
+/**
+ * \file bench.cpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ *
+ * Micro-benchmarks of the scheduling kernels on synthetic instances.
+ */
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+using namespace std;
+
+#include "batch.hpp"
+#include "heuristics.hpp"
+#include "holes.hpp"
+#include "instance.hpp"
+#include "logging.hpp"
+#include "options.hpp"
+#include "random.hpp"
+#include "solution.hpp"
+
+struct BenchOptions : public standardOptions {
+  vector<double> d;
+  vector<unsigned> n, m;
+  double mintime;
+  unsigned batch;
+  string json;
+};
+
+struct Measurement {
+  string kernel;
+  double d;
+  unsigned n, m;
+  unsigned long ops, evals;
+  double time;
+
+  double ns_per_op() const { return 1e9 * time / ops; }
+  double evals_per_sec() const { return evals / time; }
+};
+
+// random instance with processing times U[1,99], each operation missing with probability `d`
+Instance generate(unsigned n, unsigned m, double d) {
+  Instance I(n, m);
+  I.r = d;
+  uniform_int_distribution<Time> U(1, 99);
+  for (unsigned i = 1; i <= m; ++i)
+    for (unsigned j = 1; j <= n; ++j)
+      I.p[j][i] = getRandom() < d ? 0 : U(rng);
+  I.compute_auxiliary_data();
+  return I;
+}
+
+// repeat `op` until at least `mintime` seconds passed; `op` returns the number of evaluations done
+template <typename Op> Measurement measure(const string &kernel, const Instance &I, double mintime, Op op) {
+  Measurement r{kernel, I.r, I.n, I.m, 0, 0, 0.0};
+  timer t;
+  do {
+    for (unsigned rep = 0; rep != 16; ++rep) {
+      r.evals += op();
+      r.ops++;
+    }
+  } while (t.elapsed() < mintime);
+  r.time = t.elapsed();
+  return r;
+}
+
+void bench_instance(const Instance &I, const BenchOptions &opt, vector<Measurement> &M) {
+  const unsigned n = I.n;
+  uniform_int_distribution<unsigned> Uk(1, n);
+  Time sink = 0;
+
+  PSolution P(I);
+  shuffle(P.π.begin() + 1, P.π.end(), rng);
+  M.push_back(measure("compute_ms_ft_mo", I, opt.mintime, [&]() {
+    sink += P.compute_ms_ft_mo(I).second;
+    return 1;
+  }));
+
+  vector<vector<Job>> πs(opt.batch, P.π);
+  vector<const vector<Job> *> πp;
+  for (auto &π : πs) {
+    shuffle(π.begin() + 1, π.end(), rng);
+    πp.push_back(&π);
+  }
+  vector<pair<Time, Time>> r;
+  M.push_back(measure("compute_ms_ft_batch", I, opt.mintime, [&]() {
+    compute_ms_ft_batch(I, πp, n + 1, r);
+    sink += r[0].second;
+    return opt.batch;
+  }));
+
+  for (bool makespan : {true, false}) {
+    EPSolution S(I);
+    S.of_makespan = makespan;
+    S.totalTimeOrder();
+    S.clear();
+    S.insert_all();
+    M.push_back(measure(makespan ? "insert_all_ms" : "insert_all_ft", I, opt.mintime, [&]() {
+      S.remove(Uk(rng));
+      S.insert_all();
+      sink += S.of;
+      return n;
+    }));
+  }
+
+  EPSolution S(I);
+  S.of_makespan = false;
+  S.totalTimeOrder();
+  S.clear();
+  S.insert_all();
+  ENPSolution N(I, S);
+  M.push_back(measure("ENPSolution::insert_all_ft", I, opt.mintime, [&]() {
+    N.remove(Uk(rng));
+    N.insert_all();
+    sink += N.of;
+    return 2 * n * I.m;
+  }));
+
+  for (bool smallest : {false, true})
+    M.push_back(measure(smallest ? "evaluateNPSset_smallest" : "evaluateNPSset", I, opt.mintime, [&]() {
+      sink += P.evaluateNPSset(I, smallest).second;
+      return 1;
+    }));
+
+  // holes left by scheduling operations with random release times
+  hlist h;
+  const Time horizon = I.totalTime();
+  uniform_int_distribution<Time> Uc(0, horizon), Up(1, 99);
+  for (unsigned j = 0; j != 4 * n; ++j) {
+    Time p = Up(rng), C = Uc(rng);
+    auto e = h.earliest(p, C);
+    if (C <= h[e].start())
+      h.reduce(e, p);
+    else
+      h.cut(e, C, p);
+  }
+  vector<pair<Time, Time>> queries(1024);
+  for (auto &q : queries)
+    q = {Up(rng), Uc(rng)};
+  unsigned qi = 0;
+  M.push_back(measure("hlist::earliest", I, opt.mintime, [&]() {
+    auto [p, C] = queries[qi++ % queries.size()];
+    sink += h[h.earliest(p, C)].f;
+    return 1;
+  }));
+
+  if (sink == 0)
+    vprint(2, "sink {}\n", sink);
+}
+
+void write_json(ostream &out, const vector<Measurement> &M, unsigned seed) {
+  fmt::print(out, "{{\n  \"seed\": {},\n  \"results\": [\n", seed);
+  for (unsigned k = 0; k != M.size(); ++k) {
+    const auto &r = M[k];
+    fmt::print(out, "    {{\"kernel\": \"{}\", \"d\": {}, \"n\": {}, \"m\": {}, \"ops\": {}, \"time\": {:.6f}, \"ns_per_op\": {:.1f}, \"evals_per_sec\": {:.1f}}}{}\n", r.kernel, r.d, r.n, r.m, r.ops, r.time, r.ns_per_op(), r.evals_per_sec(), k + 1 != M.size() ? "," : "");
+  }
+  fmt::print(out, "  ]\n}}\n");
+}
+
+int main(int argc, char *argv[]) {
+  BenchOptions opt;
+  std_description desc("Options", opt);
+  // clang-format off
+  desc.add_options()
+    ("d",        po::value<vector<double>>(&opt.d)->multitoken()->default_value({0.2, 0.3, 0.4}, "0.2 0.3 0.4"), "Missing operation rates.")
+    ("n",        po::value<vector<unsigned>>(&opt.n)->multitoken()->default_value({5, 10, 20, 30, 50, 100}, "5 10 20 30 50 100"), "Numbers of jobs.")
+    ("m",        po::value<vector<unsigned>>(&opt.m)->multitoken()->default_value({5, 10, 20, 30}, "5 10 20 30"), "Numbers of machines.")
+    ("mintime",  po::value<double>(&opt.mintime)->default_value(0.1), "Minimum time per kernel and instance (seconds).")
+    ("batch",    po::value<unsigned>(&opt.batch)->default_value(64), "Permutations per batch evaluation.")
+    ("json",     po::value<string>(&opt.json)->default_value(""), "File to write the results in JSON to.")
+    ;
+  // clang-format on
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help")) {
+    cout << desc << endl;
+    return 0;
+  }
+  opt.seed = setupRandom(opt.seed);
+
+  vector<Measurement> M;
+  for (auto d : opt.d)
+    for (auto n : opt.n)
+      for (auto m : opt.m) {
+        Instance I = generate(n, m, d);
+        const auto mb = M.size();
+        bench_instance(I, opt, M);
+        for (auto k = mb; k != M.size(); ++k)
+          fmt::print("BENCH {} {} {} {} {:.1f} {:.1f}\n", M[k].kernel, d, n, m, M[k].ns_per_op(), M[k].evals_per_sec());
+      }
+
+  if (opt.json != "") {
+    ofstream out(opt.json);
+    if (out.fail()) {
+      fmt::print(cerr, "Failed to open {}\n", opt.json);
+      return 1;
+    }
+    write_json(out, M, opt.seed);
+  }
+}
@@ -0,0 +1,266 @@
+/**
+ * \file bnb.cpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ *
+ * Depth-first branch-and-bound over permutation prefixes. Each thread works on its own deque of nodes and steals from the front
+ * of the others' deques when it runs out. Nodes are pruned by a lower bound that combines the earliest completion times of the
+ * remaining jobs with an SPT bound per machine, and by dominance rules on the interchange of the last two jobs. Two jobs without a
+ * common machine, because of their missing operations, commute: their order changes no completion time, so only the order with
+ * the smaller job first is kept, without evaluating the interchange.
+ */
+#include "bnb.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <deque>
+#include <mutex>
+#include <thread>
+using namespace std;
+
+#include "logging.hpp"
+
+namespace {
+struct Node {
+  vector<Job> π;      // prefix
+  vector<Time> C, Cp; // machine completion times after the prefix, and before its last job
+  Time ft, ftp;       // flowtime of the prefix, and without its last job
+  uint64_t rem;       // remaining jobs, as bits of their index in `J`
+  Time lb;            // lower bound on the flowtime of all completions
+};
+
+struct BnB {
+  const Instance &I;
+  const BnBOptions &opt;
+  vector<Job> J;          // jobs with some operation
+  vector<unsigned> ix;    // index of job j in `J`
+  vector<uint64_t> share; // jobs sharing some machine with J[x], as bits of their index in `J`
+  timer start;
+
+  atomic<Time> ub;
+  mutex mx; // protects `best`
+  vector<Job> best;
+
+  struct Deque {
+    mutex mx;
+    deque<Node> d;
+  };
+  vector<Deque> dq;
+  atomic<long> pending; // nodes pushed but not yet expanded
+  atomic<bool> timeout;
+  atomic<unsigned long> nodes, pruned_bound, pruned_dominance;
+
+  BnB(const Instance &I, const BnBOptions &opt, Time ub) : I(I), opt(opt), ub(ub), dq(max(opt.threads, 1u)), pending(0), timeout(false), nodes(0), pruned_bound(0), pruned_dominance(0) {
+    ix.assign(I.n + 1, 0);
+    for (Job j = 1; j <= I.n; ++j)
+      if (I.operations(j).size() > 0) {
+        ix[j] = J.size();
+        J.push_back(j);
+      }
+    share.assign(J.size(), 0);
+    for (unsigned i = 1; i <= I.m; ++i)
+      for (unsigned x = 0; x != J.size(); ++x)
+        for (unsigned y = 0; y != J.size(); ++y)
+          if (I.pm[i][J[x]] > 0 && I.pm[i][J[y]] > 0)
+            share[x] |= uint64_t(1) << y;
+  }
+
+  // schedule `j` after the jobs that led to `C`, return its completion time
+  Time append(Job j, vector<Time> &C) const {
+    Time c = 0;
+    for (auto [i, p] : I.operations(j))
+      C[i] = c = std::max(c, C[i]) + p;
+    return c;
+  }
+
+  // lower bound on the flowtime of the jobs `rem` scheduled after the jobs that led to `C`
+  Time bound(const vector<Time> &C, uint64_t rem) const;
+
+  void push(unsigned t, Node &&v) {
+    pending++;
+    lock_guard<mutex> lock(dq[t].mx);
+    dq[t].d.push_back(std::move(v));
+  }
+  bool pop(unsigned t, Node &v) {
+    lock_guard<mutex> lock(dq[t].mx);
+    if (dq[t].d.empty())
+      return false;
+    v = std::move(dq[t].d.back());
+    dq[t].d.pop_back();
+    return true;
+  }
+  bool steal(unsigned t, Node &v) {
+    for (unsigned s = 1; s != dq.size(); ++s) {
+      auto &o = dq[(t + s) % dq.size()];
+      lock_guard<mutex> lock(o.mx);
+      if (!o.d.empty()) {
+        v = std::move(o.d.front());
+        o.d.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void offer(const vector<Job> &π, Time ft) {
+    lock_guard<mutex> lock(mx);
+    if (ft < ub) {
+      best = π;
+      ub = ft;
+      vprint(2, "* {:4.1f} {}\n", start.elapsed(), ft);
+    }
+  }
+
+  void expand(unsigned t, const Node &v);
+  void work(unsigned t);
+};
+
+Time BnB::bound(const vector<Time> &C, uint64_t rem) const {
+  if (rem == 0)
+    return 0;
+  // earliest completion time of each job, if it were scheduled next
+  Time ect = 0;
+  vector<Time> ectj(J.size(), 0);
+  for (unsigned x = 0; x != J.size(); ++x)
+    if (rem >> x & 1) {
+      Time c = 0;
+      for (auto [i, p] : I.operations(J[x]))
+        c = std::max(c, C[i]) + p;
+      ectj[x] = c;
+      ect += c;
+    }
+
+  // on machine i the jobs are processed one after another from the earliest start of any of them: their completion times are at
+  // least those of SPT order, plus the smallest remaining processing time after machine i
+  Time lb = ect;
+  vector<Time> ps;
+  for (unsigned i = 1; i <= I.m; ++i) {
+    ps.clear();
+    Time A = infinite_time, qmin = infinite_time, ecti = 0;
+    for (unsigned x = 0; x != J.size(); ++x) {
+      if (!(rem >> x & 1) || I.pm[i][J[x]] == 0)
+        continue;
+      Time h = 0, q = 0;
+      for (auto [k, p] : I.operations(J[x]))
+        if (k < i)
+          h = std::max(h, C[k]) + p;
+        else if (k > i)
+          q += p;
+      A = std::min(A, std::max(h, C[i]));
+      qmin = std::min(qmin, q);
+      ps.push_back(I.pm[i][J[x]]);
+      ecti += ectj[x];
+    }
+    if (ps.empty())
+      continue;
+    sort(ps.begin(), ps.end());
+    Time spt = 0, P = A;
+    for (auto p : ps)
+      spt += (P += p) + qmin;
+    lb = std::max(lb, ect - ecti + spt);
+  }
+  return lb;
+}
+
+void BnB::expand(unsigned t, const Node &v) {
+  nodes++;
+  vector<Node> children;
+  vector<Time> C2(I.m + 1);
+  const bool has_last = !v.π.empty();
+  const Job a = has_last ? v.π.back() : 0;
+  for (unsigned x = 0; x != J.size(); ++x) {
+    if (!(v.rem >> x & 1))
+      continue;
+    const Job b = J[x];
+    Node w{v.π, v.C, v.C, v.ft, v.ft, v.rem & ~(uint64_t(1) << x), 0};
+    w.π.push_back(b);
+    w.ft += append(b, w.C);
+
+    // prune ..., a, b if a and b commute and b<a
+    if (has_last && !(share[ix[a]] >> x & 1)) {
+      if (b < a) {
+        pruned_dominance++;
+        continue;
+      }
+    } else if (has_last) {
+      // prune ..., a, b if ..., b, a is at least as good, and better or b<a
+      C2 = v.Cp;
+      Time ft2 = v.ftp + append(b, C2);
+      ft2 += append(a, C2);
+      bool le = ft2 <= w.ft, lt = ft2 < w.ft;
+      for (unsigned i = 1; le && i <= I.m; ++i) {
+        le = C2[i] <= w.C[i];
+        lt = lt || C2[i] < w.C[i];
+      }
+      if (le && (lt || b < a)) {
+        pruned_dominance++;
+        continue;
+      }
+    }
+
+    if (w.rem == 0) {
+      offer(w.π, w.ft);
+      continue;
+    }
+    w.lb = w.ft + bound(w.C, w.rem);
+    if (w.lb >= ub) {
+      pruned_bound++;
+      continue;
+    }
+    children.push_back(std::move(w));
+  }
+  // depth first with the child of smallest bound first
+  sort(children.begin(), children.end(), [](const Node &u, const Node &w) { return u.lb > w.lb; });
+  for (auto &w : children)
+    push(t, std::move(w));
+}
+
+void BnB::work(unsigned t) {
+  Node v;
+  for (;;) {
+    if (pop(t, v) || steal(t, v)) {
+      if (!timeout && v.lb < ub)
+        expand(t, v);
+      pending--;
+      if (opt.timelimit >= 0 && start.elapsed() > opt.timelimit)
+        timeout = true;
+    } else if (pending == 0)
+      return;
+    else
+      this_thread::yield();
+  }
+}
+} // namespace
+
+BnBStat branch_and_bound(const Instance &I, PSolution &S, const BnBOptions &opt) {
+  BnB bb(I, opt, S.getFlowtime(I));
+  assert(bb.J.size() <= bnb_max_jobs);
+
+  Node root{{}, vector<Time>(I.m + 1, 0), {}, 0, 0, bb.J.size() == 64 ? ~uint64_t(0) : (uint64_t(1) << bb.J.size()) - 1, 0};
+  root.lb = bb.bound(root.C, root.rem);
+  if (bb.J.empty())
+    bb.offer({}, 0);
+  else
+    bb.push(0, std::move(root));
+
+  vector<thread> T;
+  for (unsigned t = 1; t < bb.dq.size(); ++t)
+    T.emplace_back([&bb, t] { bb.work(t); });
+  bb.work(0);
+  for (auto &th : T)
+    th.join();
+
+  if (!bb.best.empty() || bb.J.empty()) {
+    vector<bool> placed(I.n + 1, false);
+    unsigned k = 1;
+    for (auto j : bb.best) {
+      S.π[k++] = j;
+      placed[j] = true;
+    }
+    for (Job j = 1; j <= I.n; ++j)
+      if (!placed[j])
+        S.π[k++] = j;
+  }
+  S.of = S.getFlowtime(I);
+  return BnBStat{bb.nodes, bb.pruned_bound, bb.pruned_dominance, !bb.timeout};
+}
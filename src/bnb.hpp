@@ -0,0 +1,30 @@
+/**
+ * \file bnb.hpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ *
+ * Parallel branch-and-bound for the permutation flow shop with missing operations and the flowtime objective.
+ */
+#pragma once
+
+#include "instance.hpp"
+#include "solution.hpp"
+
+struct BnBOptions {
+  unsigned threads;
+  double timelimit; // seconds, negative for none
+
+  BnBOptions() : threads(1), timelimit(-1) {}
+};
+
+struct BnBStat {
+  unsigned long nodes, pruned_bound, pruned_dominance;
+  bool optimal;
+  std::string to_string() const { return fmt::format("{} {} {}", nodes, pruned_bound, pruned_dominance); }
+};
+
+// maximum number of jobs with some operation
+constexpr unsigned bnb_max_jobs = 64;
+
+// Minimize the flowtime over all permutations, starting from the upper bound given by `S`, which receives the best permutation
+// found. Jobs without operations complete at time 0 and are put last.
+BnBStat branch_and_bound(const Instance &I, PSolution &S, const BnBOptions &opt);
@@ -0,0 +1,104 @@
+/**
+ * \file bounds.cpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ */
+#include "bounds.hpp"
+
+#include <algorithm>
+#include <queue>
+using namespace std;
+
+namespace {
+// operation on one machine with release time, processing time, and tail
+struct Op {
+  Time r, p, q;
+};
+
+// minimum total completion time of the operations with preemption, by shortest remaining processing time first
+Time srpt(vector<Op> &O) {
+  sort(O.begin(), O.end(), [](const Op &a, const Op &b) { return a.r < b.r; });
+  priority_queue<Time, vector<Time>, greater<Time>> Q; // remaining processing times
+  Time t = 0, sum = 0;
+  unsigned k = 0;
+  while (k != O.size() || !Q.empty()) {
+    if (Q.empty())
+      t = max(t, O[k].r);
+    for (; k != O.size() && O[k].r <= t; ++k)
+      Q.push(O[k].p);
+    const Time p = Q.top(), next = k != O.size() ? O[k].r : infinite_time;
+    Q.pop();
+    if (t + p <= next) {
+      t += p;
+      sum += t;
+    } else {
+      Q.push(p - (next - t));
+      t = next;
+    }
+  }
+  return sum;
+}
+
+// minimum over preemptive schedules of the latest completion time plus tail, by largest tail first
+Time jackson(vector<Op> &O) {
+  sort(O.begin(), O.end(), [](const Op &a, const Op &b) { return a.r < b.r; });
+  priority_queue<pair<Time, Time>> Q; // tail and remaining processing time
+  Time t = 0, lb = 0;
+  unsigned k = 0;
+  while (k != O.size() || !Q.empty()) {
+    if (Q.empty())
+      t = max(t, O[k].r);
+    for (; k != O.size() && O[k].r <= t; ++k)
+      Q.push({O[k].q, O[k].p});
+    auto [q, p] = Q.top();
+    const Time next = k != O.size() ? O[k].r : infinite_time;
+    Q.pop();
+    if (t + p <= next) {
+      t += p;
+      lb = max(lb, t + q);
+    } else {
+      Q.push({q, p - (next - t)});
+      t = next;
+    }
+  }
+  return lb;
+}
+} // namespace
+
+Bounds lower_bounds(const Instance &I) {
+  vector<Time> total(I.n + 1, 0);
+  for (Job j = 1; j <= I.n; ++j)
+    for (auto [i, p] : I.operations(j))
+      total[j] += p;
+
+  // a job completes no earlier than its total processing time
+  Bounds lb{0, 0};
+  Time ftotal = 0;
+  for (Job j = 1; j <= I.n; ++j) {
+    lb.ms = max(lb.ms, total[j]);
+    ftotal += total[j];
+  }
+  lb.ft = ftotal;
+
+  vector<Op> O;
+  for (unsigned i = 1; i <= I.m; ++i) {
+    O.clear();
+    Time ft = ftotal, q = 0;
+    for (Job j = 1; j <= I.n; ++j) {
+      const Time p = I.pm[i][j];
+      if (p == 0)
+        continue;
+      Time r = 0;
+      for (auto [k, pk] : I.operations(j))
+        if (k < i)
+          r += pk;
+      O.push_back({r, p, total[j] - r - p});
+      ft -= total[j];
+      q += total[j] - r - p;
+    }
+    if (O.empty())
+      continue;
+    lb.ms = max(lb.ms, jackson(O));
+    lb.ft = max(lb.ft, ft + q + srpt(O));
+  }
+  return lb;
+}
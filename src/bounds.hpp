@@ -0,0 +1,24 @@
+/**
+ * \file bounds.hpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ *
+ * Lower bounds on the makespan and the flowtime.
+ */
+#pragma once
+
+#include <string>
+
+#define FMT_HEADER_ONLY
+#include "fmt/format.h"
+
+#include "instance.hpp"
+
+struct Bounds {
+  Time ms, ft;
+  std::string to_string() const { return fmt::format("{} {}", ms, ft); }
+};
+
+// Lower bounds from one-machine relaxations: each operation is released after the operations of its job on earlier machines, and
+// its job completes no earlier than the processing time on later machines after it. They ignore the job order on other
+// machines, and so hold for permutation and non-permutation schedules.
+Bounds lower_bounds(const Instance &I);
@@ -0,0 +1,120 @@
+/**
+ * \file campaign.cpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ */
+#include "campaign.hpp"
+
+#include <glob.h>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <thread>
+namespace fs = std::filesystem;
+using namespace std;
+
+#include "logging.hpp"
+
+vector<string> campaign_instances(const string &spec) {
+  vector<string> instances;
+  if (fs::is_directory(spec)) {
+    for (auto &e : fs::directory_iterator(spec))
+      if (e.is_regular_file() && (e.path().extension() == ".txt" || e.path().extension() == ".bin"))
+        instances.push_back(e.path().string());
+  } else if (spec.find_first_of("*?[") != string::npos) {
+    glob_t g;
+    if (glob(spec.c_str(), 0, nullptr, &g) == 0)
+      for (size_t k = 0; k != g.gl_pathc; ++k)
+        instances.push_back(g.gl_pathv[k]);
+    globfree(&g);
+  } else {
+    ifstream manifest(spec);
+    if (manifest.fail())
+      fmt::print(cerr, "Failed to open {}\n", spec);
+    const fs::path base = fs::path(spec).parent_path();
+    string line;
+    while (getline(manifest, line))
+      if (line != "" && line[0] != '#')
+        instances.push_back(fs::path(line).is_absolute() ? line : (base / line).string());
+  }
+  sort(instances.begin(), instances.end());
+  return instances;
+}
+
+unsigned count_fields(const string &row) { return count(row.begin(), row.end(), ',') + 1; }
+
+// collect the instances completed in `results`; incomplete rows left by an interrupted run are dropped
+bool resume(const string &results, const string &header, set<string> &done) {
+  if (!fs::exists(results) || fs::file_size(results) == 0)
+    return true;
+
+  ifstream in(results);
+  vector<string> rows;
+  string row;
+  if (!getline(in, row) || row != header) {
+    fmt::print(cerr, "{} is not a results file of this campaign.\n", results);
+    return false;
+  }
+  while (getline(in, row) && !in.eof())
+    if (count_fields(row) == count_fields(header)) {
+      rows.push_back(row);
+      done.insert(row.substr(row.rfind(',') + 1));
+    }
+  in.close();
+
+  const string tmp = results + ".tmp";
+  ofstream out(tmp);
+  fmt::print(out, "{}\n", header);
+  for (auto &r : rows)
+    fmt::print(out, "{}\n", r);
+  out.close();
+  fs::rename(tmp, results);
+  return true;
+}
+
+int run_campaign(const vector<string> &instances, const string &results, const string &header, unsigned workers, function<bool(const string &, string &)> solve) {
+  const string fheader = header + ",file";
+  set<string> done;
+  if (!resume(results, fheader, done))
+    return 1;
+  const bool fresh = !fs::exists(results) || fs::file_size(results) == 0;
+  vector<string> todo;
+  for (auto &i : instances)
+    if (done.count(i) == 0)
+      todo.push_back(i);
+  vprint(1, "Campaign with {} instances, {} done, {} to solve.\n", instances.size(), instances.size() - todo.size(), todo.size());
+
+  ofstream out(results, ios::app);
+  if (out.fail()) {
+    fmt::print(cerr, "Failed to open {}\n", results);
+    return 1;
+  }
+  if (fresh)
+    fmt::print(out, "{}\n", fheader);
+  out.flush();
+
+  mutex mx;
+  atomic<unsigned> next(0), failed(0);
+  auto work = [&]() {
+    string row;
+    for (unsigned k = next++; k < todo.size(); k = next++) {
+      if (!solve(todo[k], row)) {
+        failed++;
+        continue;
+      }
+      lock_guard<mutex> lock(mx);
+      fmt::print(out, "{},{}\n", row, todo[k]);
+      out.flush();
+    }
+  };
+  vector<thread> W;
+  for (unsigned t = 1; t < workers; ++t)
+    W.emplace_back(work);
+  work();
+  for (auto &w : W)
+    w.join();
+  return failed > 0 ? 1 : 0;
+}
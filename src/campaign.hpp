@@ -0,0 +1,19 @@
+/**
+ * \file campaign.hpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ *
+ * Solving many instances in one process.
+ */
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// instances given by a directory (all .txt and .bin files), a glob pattern, or a manifest file with one instance per line (relative to the manifest)
+std::vector<std::string> campaign_instances(const std::string &);
+
+// Solve `instances` with `workers` threads. `solve(instance, row)` returns false on failure, and otherwise a row of CSV values,
+// which is appended to `results` together with the instance. Instances already in `results` are skipped, so an interrupted
+// campaign can be resumed. Returns the process exit status.
+int run_campaign(const std::vector<std::string> &instances, const std::string &results, const std::string &header, unsigned workers, std::function<bool(const std::string &, std::string &)> solve);
@@ -0,0 +1,57 @@
+/**
+ * \file convert.cpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ *
+ * Conversion of instances in Henneberg & Neufeld's text format to the binary format.
+ */
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+namespace fs = std::filesystem;
+using namespace std;
+
+#include "instance.hpp"
+#include "logging.hpp"
+#include "options.hpp"
+
+struct ConvertOptions : public standardOptions {
+  string output;
+};
+
+int main(int argc, char *argv[]) {
+  ConvertOptions opt;
+  std_description desc("Options", opt);
+  desc.add_options()("output", po::value<string>(&opt.output)->default_value(""), "Binary instance to write (default: the instance with extension .bin).");
+
+  po::positional_options_description pod;
+  pod.add("instance", 1).add("output", 1);
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).options(desc).positional(pod).run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help") || !vm.count("instance")) {
+    if (!vm.count("instance"))
+      fmt::print("No instance given.\n\n");
+    cout << desc << endl;
+    return 0;
+  }
+  if (opt.output == "")
+    opt.output = fs::path(opt.instance).replace_extension(".bin").string();
+
+  ifstream ins(opt.instance);
+  if (ins.fail()) {
+    fmt::print(cerr, "Failed to open {}\n", opt.instance);
+    return 1;
+  }
+  Instance I;
+  I.read_hn(ins);
+
+  ofstream out(opt.output, ios::binary);
+  if (out.fail()) {
+    fmt::print(cerr, "Failed to open {}\n", opt.output);
+    return 1;
+  }
+  I.write_binary(out);
+  vprint(1, "Wrote {} jobs and {} machines to {}.\n", I.n, I.m, opt.output);
+}
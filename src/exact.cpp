@@ -6,6 +6,7 @@
 #include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <thread>
 namespace fs = std::filesystem;
 
 using namespace std;
@@ -18,6 +19,7 @@ using namespace std;
 #include "random.hpp"
 
 struct SolverOptions : public standardOptions, public ModelOptions {
+  bool heuristic;
   string solution;
 };
 
@@ -27,6 +29,8 @@ int main(int argc, char *argv[]) {
   // clang-format off
   desc.add_options()
     ("timelimit",    po::value<unsigned>(&opt.timelimit)->default_value(0),   "Time limit (seconds).")
+    ("threads",      po::value<unsigned>(&opt.threads)->default_value(1),     "Number of CPLEX threads.")
+    ("heuristic",    po::bool_switch(&opt.heuristic)->default_value(false),   "Run the IGA and the NP local search concurrently, passing their improvements to CPLEX.")
     ;
 
   po::options_description out("Output options", get_terminal_width());
@@ -92,11 +96,36 @@ int main(int argc, char *argv[]) {
 
   ModelStat mstat{0, 0, 0};
   MPFSMO m(I, opt);
-  m.build(S.getMakespan(I));
+  m.build(S.getFlowtime(I));
+
+  // the heuristic continues the IGA from its solution in rounds, and improves each result by the NP local search
+  SharedSolution shared(I);
+  atomic<bool> done(false);
+  thread heuristic;
+  if (opt.heuristic)
+    heuristic = thread([&, start = run::start] {
+      run::start = start;
+      setupRandom(opt.seed + 1);
+      EPSolution H(S);
+      IGAOptions hopt = iopt;
+      hopt.cancel = &done;
+      while (!done) {
+        H.iga(hopt);
+        ENPSolution N(I, H);
+        N.limits = &hopt;
+        N.shift_ls();
+        if (done)
+          break;
+        shared.offer(N);
+      }
+    });
 
   IloAlgorithm::Status status = IloAlgorithm::Unknown;
   NPSolution Sm(I);
-  tie(Sm, status) = m.solve(S);
+  tie(Sm, status) = m.solve(S, opt.heuristic ? &shared : nullptr);
+  done = true;
+  if (heuristic.joinable())
+    heuristic.join();
   results.push_back(Result{Sm.getMakespan(I), Sm.of, run::elapsed()});
   vprint(1, "Model results {}\n", results.back().to_string());
   mstat = m.getStatistics();
@@ -0,0 +1,139 @@
+/**
+ * \file exact_bnb.cpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ *
+ * Exact solution of small permutation flow shops with missing operations and flowtime objective by branch-and-bound.
+ */
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+namespace fs = std::filesystem;
+
+using namespace std;
+
+#include "bnb.hpp"
+#include "helpers.hpp"
+#include "heuristics.hpp"
+#include "logging.hpp"
+#include "options.hpp"
+#include "random.hpp"
+
+struct SolverOptions : public standardOptions {
+  double timelimit;
+  unsigned threads;
+  string solution;
+};
+
+int main(int argc, char *argv[]) {
+  SolverOptions opt;
+  std_description desc("Options", opt);
+  // clang-format off
+  desc.add_options()
+    ("timelimit",    po::value<double>(&opt.timelimit)->default_value(-1),                           "Time limit for the branch-and-bound (seconds, negative for none).")
+    ("threads",      po::value<unsigned>(&opt.threads)->default_value(thread::hardware_concurrency()), "Number of threads.")
+    ;
+
+  po::options_description out("Output options", get_terminal_width());
+  out.add_options()
+    ("solution",     po::value<string>(&opt.solution)->default_value("/dev/null"), "File to write solution to.")
+    ;
+  // clang-format on
+
+  desc.add(out);
+
+  po::positional_options_description pod;
+  pod.add("instance", 1);
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).options(desc).positional(pod).run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help") || !vm.count("instance")) {
+    if (!vm.count("instance"))
+      fmt::print("No instance given.\n\n");
+    cout << desc << endl;
+    return 0;
+  }
+  opt.seed = setupRandom(opt.seed);
+
+  string iname = canonical_name(fs::path(opt.instance).filename());
+  Instance I;
+  if (Instance::is_binary(opt.instance)) {
+    if (!I.read_binary(opt.instance)) {
+      fmt::print(cerr, "Failed to read {}\n", opt.instance);
+      return 1;
+    }
+  } else {
+    ifstream ins(opt.instance);
+    if (ins.fail()) {
+      fmt::print(cerr, "Failed to open {}\n", opt.instance);
+      return 1;
+    }
+    I.read_hn(ins);
+  }
+
+  vprint(1, "Instance with {} jobs and {} machines, missing operations rate {}.\n", I.n, I.m, I.r);
+  unsigned nj = 0;
+  for (Job j = 1; j <= I.n; ++j)
+    nj += I.operations(j).size() > 0;
+  if (nj > bnb_max_jobs) {
+    fmt::print(cerr, "Branch-and-bound supports at most {} jobs with operations, instance has {}.\n", bnb_max_jobs, nj);
+    return 1;
+  }
+
+  IGAOptions iopt;
+  const double iterfactor = 0.1;
+  iopt.iterlimit = max(1.0, iterfactor * double(150000) / I.n);
+  // the perturbation keeps at least one job in the sequence
+  iopt.dc = min({iopt.dc, (8 * I.n + 9) / 10, I.n - 1});
+  vprint(1, "Iteration limit for IGA {}, dc {}.\n", iopt.iterlimit, iopt.dc);
+
+  EPSolution S(I);
+  S.of_makespan = false;
+
+  vector<Result> results;
+
+  S.totalTimeOrder();
+  S.clear();
+  S.insert_all();
+  S.store_so();
+  S.tfound = run::elapsed();
+
+  const double pavg = double(I.totalTime()) / (I.n * I.m);
+  iopt.T = iopt.alpha * pavg / 10;
+  iopt.timelimit = infinite_time;
+
+  if (I.n > 1)
+    S.iga(iopt);
+  results.push_back(S.getResultPO());
+  vprint(1, "IGA {}\n", results.back().to_string());
+
+  BnBOptions bopt;
+  bopt.threads = max(opt.threads, 1u);
+  bopt.timelimit = opt.timelimit;
+  PSolution Sb(S);
+  BnBStat bstat = branch_and_bound(I, Sb, bopt);
+  results.push_back(Result{Sb.getMakespan(I), Sb.of, run::elapsed()});
+  vprint(1, "Branch-and-bound {}\n", results.back().to_string());
+
+  fmt::print("INFO {} ", iname);
+  for (auto res : results)
+    fmt::print("{} ", res.to_string());
+  fmt::print("{} ", bstat.optimal ? "Optimal" : "Feasible");
+  fmt::print("\n");
+  fmt::print("STAT {} {}\n", iname, bstat.to_string());
+
+  if (opt.solution != "/dev/null") {
+    ofstream sol(opt.solution);
+    if (sol.fail()) {
+      fmt::print(cerr, "Failed to open {}\n", opt.solution);
+      return 1;
+    }
+    Sb.write(sol);
+    sol.close();
+  }
+}
@@ -11,7 +11,7 @@ using namespace std;
 #include "fmt/format.h"
 
 string canonical_name(string fname) {
-  const regex hn_fname("([\\d\\.]+)_(\\d+)_(\\d+)_(\\d+)\\.txt");
+  const regex hn_fname("([\\d\\.]+)_(\\d+)_(\\d+)_(\\d+)\\.(txt|bin)");
   std::smatch match;
   if (regex_match(fname, match, hn_fname))
     return fmt::format("{} {} {} {}", match[1].str(), match[2].str(), match[3].str(), match[4].str());
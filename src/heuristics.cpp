@@ -7,9 +7,12 @@
 #include <cassert>
 #include <cstdlib>
 #include <iostream>
+#include <thread>
 using namespace std;
 
+#include "alloc.hpp"
 #include "helpers.hpp"
+#include "profile.hpp"
 #include "random.hpp"
 
 void EPSolution::clear() { fbegin = 1; }
@@ -54,10 +57,95 @@ void EPSolution::update_tails(unsigned kb, unsigned ke) {
   }
 }
 
+pair<Time, Time> EPSolution::evaluate() {
+  if (!of_npsset)
+    return compute_ms_ft_mo(I, ws.C);
+  PROFILE_SCOPE(evaluateNPSset);
+  PROFILE_EVALUATIONS(1);
+  if (npsc.h.size() != m) {
+    npsc = NPSState(m);
+    npsc.reserve(n);
+  }
+  npsc.reset();
+  for (unsigned k = 1; k != fbegin; ++k)
+    npsc.add(I, π[k]);
+  return {npsc.ms, npsc.ft};
+}
+
 bool EPSolution::makespan_valid(Time Cm) { return Cm == compute_ms_ft_mo(I).first; }
 bool EPSolution::flowtime_valid(Time Cf) { return Cf == compute_ms_ft_mo(I).second; }
 
+// makespan and idle time `Ik` when inserting job `jb` at position `k`; stops early when the makespan exceeds `Cm`
+Time EPSolution::insert_ms_at(unsigned jb, unsigned k, Time Cm, Time &Ik) const {
+  Time Cmaxk = 0, Cj = 0, Cjk = 0, Ci = 0;
+  for (unsigned i = 1; i <= m; ++i) {
+    if (I.p[jb][i] > 0)
+      Ci = Cj = std::max(Cj, h[i][k - 1]) + I.p[jb][i];
+    else
+      Ci = h[i][k - 1];
+    Cmaxk = std::max(Cmaxk, Ci + t[i][fbegin - k]);
+    if (Cmaxk > Cm)
+      break;
+    if (k < fbegin) {
+      if (I.p[π[k]][i] > 0) {
+        Cjk = std::max(Ci, Cjk) + I.p[π[k]][i];
+        assert(Cjk >= h[i][k]);
+        Ik += Cjk - h[i][k];
+      } else {
+        assert(Ci >= h[i][k]);
+        Ik += Ci - h[i][k];
+      }
+    } else if (I.p[jb][i] > 0) {
+      assert(Cj >= h[i][k - 1]);
+      Ik += Cj - h[i][k - 1];
+    }
+  }
+  return Cmaxk;
+}
+
+// scan the insertion positions of `jb` in parallel: threads take chunks of positions in decreasing order, keep their own best,
+// and share the best makespan for pruning; the reduction breaks ties like the sequential scan (idle time, then larger position)
+void EPSolution::insert_ms_parallel(unsigned jb, unsigned &bp, Time &Cm, unsigned &Ip) {
+  struct Best {
+    Time Cm;
+    unsigned Ip, bp;
+  };
+  const unsigned chunk = 16, nc = (fbegin + chunk - 1) / chunk;
+  atomic<unsigned> next(0);
+  atomic<Time> bound(infinite_time);
+  vector<Best> best(pool->size(), Best{infinite_time, uinf, 0});
+
+  pool->run([&](unsigned t) {
+    Best b = best[t];
+    for (unsigned c = next++; c < nc; c = next++) {
+      const unsigned kb = fbegin - c * chunk, ke = kb > chunk ? kb - chunk : 0;
+      for (unsigned k = kb; k != ke; --k) {
+        const Time Cb = std::min(b.Cm, bound.load(memory_order_relaxed));
+        Time Ik = 0;
+        const Time Cmaxk = insert_ms_at(jb, k, Cb, Ik);
+        if (Cmaxk > Cb)
+          continue;
+        if (Cmaxk < b.Cm || (Cmaxk == b.Cm && Ik < b.Ip)) {
+          b = Best{Cmaxk, unsigned(Ik), k};
+          Time Cg = bound.load(memory_order_relaxed);
+          while (b.Cm < Cg && !bound.compare_exchange_weak(Cg, b.Cm))
+            ;
+        }
+      }
+    }
+    best[t] = b;
+  });
+
+  for (auto &b : best)
+    if (b.Cm < Cm || (b.Cm == Cm && (b.Ip < Ip || (b.Ip == Ip && b.bp > bp)))) {
+      Cm = b.Cm;
+      Ip = b.Ip;
+      bp = b.bp;
+    }
+}
+
 void EPSolution::insert_all_ms() {
+  PROFILE_SCOPE(insert_all_ms);
   update_heads(1, fbegin);
   update_tails(1, fbegin);
 
@@ -67,37 +155,19 @@ void EPSolution::insert_all_ms() {
 
     unsigned bp = 0, Ip = uinf;
     Cm = infinite_time;
-    for (unsigned k = fbegin; k >= 1; --k) {
-      Time Cmaxk = 0, Cj = 0, Cjk = 0, Ik = 0, Ci = 0;
-      for (unsigned i = 1; i <= m; ++i) {
-        if (I.p[jb][i] > 0)
-          Ci = Cj = std::max(Cj, h[i][k - 1]) + I.p[jb][i];
-        else
-          Ci = h[i][k - 1];
-        Cmaxk = std::max(Cmaxk, Ci + t[i][fbegin - k]);
-        if (Cmaxk > Cm)
-          break;
-        if (k < fbegin) {
-          if (I.p[π[k]][i] > 0) {
-            Cjk = std::max(Ci, Cjk) + I.p[π[k]][i];
-            assert(Cjk >= h[i][k]);
-            Ik += Cjk - h[i][k];
-          } else {
-            assert(Ci >= h[i][k]);
-            Ik += Ci - h[i][k];
-          }
-        } else if (I.p[jb][i] > 0) {
-          assert(Cj >= h[i][k - 1]);
-          Ik += Cj - h[i][k - 1];
+    PROFILE_EVALUATIONS(fbegin);
+    if (pool != nullptr && fbegin >= parallel_min)
+      insert_ms_parallel(jb, bp, Cm, Ip);
+    else
+      for (unsigned k = fbegin; k >= 1; --k) {
+        Time Ik = 0;
+        const Time Cmaxk = insert_ms_at(jb, k, Cm, Ik);
+        if (Cmaxk < Cm || (Cmaxk == Cm && Ik < Ip)) {
+          Cm = Cmaxk;
+          bp = k;
+          Ip = Ik;
         }
       }
-      if (Cmaxk < Cm || (Cmaxk == Cm && Ik < Ip)) {
-
-        Cm = Cmaxk;
-        bp = k;
-        Ip = Ik;
-      }
-    }
 
     assert(bp <= fbegin);
     if (bp < fbegin)
@@ -116,20 +186,41 @@ void EPSolution::insert_all_ms() {
 }
 
 void EPSolution::insert_all_ft() {
-  vector<Time> ftk(I.n + 1, 0);
+  PROFILE_SCOPE(insert_all_ft);
+  auto &ftk = ws.ftk, &C = ws.C;
+  auto &nk = ws.nk; // number of jobs with some operation in prefix 1..k
+  auto update_counts = [&](unsigned kb, unsigned ke) {
+    for (unsigned k = kb; k != ke; ++k)
+      nk[k] = nk[k - 1] + (ftk[k] != ftk[k - 1]);
+  };
   update_heads_flowtimes(1, fbegin, ftk);
+  update_counts(1, fbegin);
   update_tails(1, fbegin);
 
+  // if completion times `C` after position `l` are the heads shifted by a constant δ, all
+  // later jobs are delayed by exactly δ, and the remaining flowtime follows from `ftk`
+  auto shifted = [&](unsigned l, Time &δ) {
+    δ = C[1] - h[1][l];
+    for (unsigned i = 2; i <= m; ++i)
+      if (C[i] - h[i][l] != δ)
+        return false;
+    return true;
+  };
+
   Time Cm = 0, Cf = 0;
   for (auto πend = π.size(); fbegin != πend;) {
     const unsigned jb = π[fbegin];
+    const Time ftend = ftk[fbegin - 1];
+    Time Hmax = 0;
+    for (unsigned i = 1; i <= m; ++i)
+      Hmax = std::max(Hmax, h[i][fbegin - 1]);
 
     unsigned bp = 0;
     Cm = Cf = infinite_time;
 
     for (unsigned k = fbegin; k >= 1; --k) {
+      PROFILE_EVALUATIONS(1);
       Time fk = ftk[k - 1];
-      vector<Time> C(m + 1, 0);
 
       Time Cj = 0;
       for (unsigned i = 1; i <= m; ++i) {
@@ -142,18 +233,27 @@ void EPSolution::insert_all_ft() {
       if (fk > Cf)
         break;
 
-      for (unsigned l = k; l != fbegin; ++l) {
-        Cj = 0;
-        for (unsigned i = 1; i <= m; ++i) {
-          if (I.p[π[l]][i] > 0)
-            C[i] = Cj = std::max(Cj, C[i]) + I.p[π[l]][i];
-        }
-        fk += Cj;
-        if (fk > Cf)
+      Time Cmaxk = 0, δ = 0;
+      bool done = false;
+      for (unsigned l = k; !done; ++l) {
+        if (shifted(l - 1, δ)) {
+          fk += ftend - ftk[l - 1] + δ * (nk[fbegin - 1] - nk[l - 1]);
+          Cmaxk = Hmax + δ;
+          done = true;
+        } else if (l == fbegin) {
+          Cmaxk = *max_element(C.begin() + 1, C.end());
+          done = true;
+        } else if (fk + ftend - ftk[l - 1] > Cf) {
+          fk += ftend - ftk[l - 1];
           break;
+        } else {
+          Cj = 0;
+          for (auto [i, p] : I.operations(π[l]))
+            C[i] = Cj = std::max(Cj, C[i]) + p;
+          fk += Cj;
+        }
       }
 
-      Time Cmaxk = *max_element(C.begin(), C.end());
       if (fk < Cf || (fk == Cf && Cmaxk < Cm)) {
         Cf = fk;
         Cm = Cmaxk;
@@ -168,6 +268,7 @@ void EPSolution::insert_all_ft() {
 
     if (fbegin != πend) {
       update_heads_flowtimes(bp, fbegin, ftk);
+      update_counts(bp, fbegin);
       assert(bp + 1 <= fbegin);
       update_tails(fbegin - bp, fbegin);
     }
@@ -178,28 +279,160 @@ void EPSolution::insert_all_ft() {
   of = Cf;
 }
 
+void EPSolution::update_nps(unsigned kb, unsigned ke) {
+  for (unsigned k = kb; k != ke; ++k) {
+    nps[k] = nps[k - 1];
+    nps[k].add(I, π[k], false, buffer > 0 ? st[π[k]].begin() : nullptr);
+  }
+}
+
+// Peak number of jobs waiting between machines, as in `computeBufferspace`, of the NPS-set decoding of jobs π[1,...,k) with start
+// times in `st`, and `jb` (if not 0) and π[k,...,l) with start times in `stc`. The decoding is semi-active for the machine sequences
+// ordered by start time, which define the waiting intervals. Adding a job to the decoding only extends the waiting intervals of the
+// others, so the peak of a partial decoding bounds that of the complete one from below.
+unsigned EPSolution::nps_peak(unsigned k, unsigned l, Job jb) {
+  rows.clear();
+  for (unsigned q = 1; q != k; ++q)
+    rows.push_back({π[q], st[π[q]].begin()});
+  if (jb != 0)
+    rows.push_back({jb, stc[jb].begin()});
+  for (unsigned q = k; q != l; ++q)
+    rows.push_back({π[q], stc[π[q]].begin()});
+
+  events.clear();
+  for (unsigned i = 1; i < m; ++i) {
+    ops.clear();
+    for (auto [j, S] : rows)
+      if (I.pm[i][j] > 0)
+        ops.push_back({S[i], j, S});
+    sort(ops.begin(), ops.end());
+    for (unsigned q = 1; q < ops.size(); ++q) {
+      const auto [s, j, S] = ops[q - 1];
+      const unsigned nm = I.nextOperation(i, j);
+      if (nm == m + 1)
+        continue;
+      const Time Sⱼ = S[nm], Cⱼ = std::min(get<0>(ops[q]), Sⱼ);
+      if (Cⱼ < Sⱼ) {
+        events.push_back({Cⱼ, 1});
+        events.push_back({Sⱼ, -1});
+      }
+    }
+  }
+  // jobs leave before others arrive at the same time
+  sort(events.begin(), events.end());
+  unsigned bs = 0, mbs = 0;
+  for (auto [t, d] : events) {
+    bs += d;
+    mbs = std::max(mbs, bs);
+  }
+  return mbs;
+}
+
+unsigned EPSolution::nps_bufferspace() {
+  if (npsc.h.size() != m) {
+    npsc = NPSState(m);
+    npsc.reserve(n);
+  }
+  if (st.shape()[0] != n + 1)
+    st.resize(n + 1, m + 1);
+  npsc.reset();
+  for (unsigned k = 1; k != fbegin; ++k)
+    npsc.add(I, π[k], false, st[π[k]].begin());
+  return nps_peak(fbegin, fbegin, 0);
+}
+
+// Insertion for the NPS-set decoding. The decoder states after each prefix are kept, so inserting at position k replays only the
+// job and the suffix k,...,fbegin-1, and stops once the primary objective exceeds the best one. With a buffer limit, positions are
+// compared by the excess of the decoding over the limit first; the replay then stops once also the excess of the partial decoding
+// reaches the best one.
+void EPSolution::insert_all_nps() {
+  PROFILE_SCOPE(insert_all_nps);
+  if (nps.size() != n + 1) {
+    nps.assign(n + 1, NPSState(m));
+    for (auto &S : nps)
+      S.reserve(n);
+    npsc = NPSState(m);
+    npsc.reserve(n);
+  }
+  if (buffer > 0 && st.shape()[0] != n + 1) {
+    st.resize(n + 1, m + 1);
+    stc.resize(n + 1, m + 1);
+  }
+  nps[0].reset();
+  update_nps(1, fbegin);
+
+  auto value = [&](const NPSState &S) { return of_makespan ? std::make_pair(S.ms, S.ft) : std::make_pair(S.ft, S.ms); };
+  auto start = [&](Job j) { return buffer > 0 ? stc[j].begin() : nullptr; };
+  auto over = [&](unsigned peak) { return peak > buffer ? peak - buffer : 0; };
+  for (auto πend = π.size(); fbegin != πend;) {
+    const unsigned jb = π[fbegin];
+
+    unsigned bp = 0, bx = buffer > 0 ? ~0u : 0;
+    pair<Time, Time> bv{infinite_time, infinite_time};
+    for (unsigned k = fbegin; k >= 1; --k) {
+      PROFILE_EVALUATIONS(1);
+      npsc = nps[k - 1];
+      npsc.add(I, jb, false, start(jb));
+      unsigned l = k;
+      bool bound = true;
+      for (; l != fbegin; ++l) {
+        if (bound && value(npsc).first > bv.first) {
+          if (bx == 0 || over(nps_peak(k, l, jb)) >= bx)
+            break;
+          bound = false; // the excess may still improve, so replay all
+        }
+        npsc.add(I, π[l], false, start(π[l]));
+      }
+      if (l != fbegin || (bx == 0 && !(value(npsc) < bv)))
+        continue;
+      const unsigned x = buffer > 0 ? over(nps_peak(k, fbegin, jb)) : 0;
+      if (make_pair(x, value(npsc)) < make_pair(bx, bv)) {
+        bx = x;
+        bv = value(npsc);
+        bp = k;
+      }
+    }
+
+    assert(bp <= fbegin);
+    if (bp < fbegin)
+      rotate(π.begin() + bp, π.begin() + fbegin, π.begin() + fbegin + 1);
+    fbegin++;
+    update_nps(bp, fbegin);
+    excess = bx;
+  }
+  of = value(nps[fbegin - 1]).first;
+  assert(of == (of_makespan ? evaluateNPSset(I).first : evaluateNPSset(I).second));
+  assert(buffer == 0 || excess == over(nps_peak(fbegin, fbegin, 0)));
+}
+
 void EPSolution::shuffle_free() { shuffle(π.begin() + fbegin, π.end(), rng); }
 
 void EPSolution::remove(unsigned k) {
+  PROFILE_SCOPE(remove);
   rotate(π.begin() + k, π.begin() + k + 1, π.begin() + fbegin);
   fbegin--;
 }
 
 bool EPSolution::shift_step() {
-  Time of_ = of;
+  const auto of_ = make_pair(excess, of);
   for (auto j = 1u; j <= n; ++j) {
     remove(j);
     insert_all();
     store_so();
   }
-  assert(of <= of_);
-  return of < of_;
+  assert(make_pair(excess, of) <= of_);
+  return make_pair(excess, of) < of_;
 }
 
 unsigned EPSolution::shift_ls() {
   store_so();
   unsigned steps = 0;
-  while (shift_step()) {
+  for (;;) {
+    const bool improved = shift_step();
+    if (trace)
+      trace->record(TraceEvent{run::elapsed(), 'S', steps, of, of, insertions, improved});
+    if (!improved)
+      break;
     tfound = run::elapsed();
     steps++;
     vprint(3, "{}\n", of);
@@ -209,7 +442,8 @@ unsigned EPSolution::shift_ls() {
 
 void EPSolution::iga_perturb(unsigned dc) {
   assert(fbegin - 1 > dc);
-  auto is = sample_floyd(dc, fbegin - 1);
+  auto &is = ws.is;
+  sample_floyd(dc, fbegin - 1, is);
   transform(is.begin(), is.end(), is.begin(), [](auto e) { return e + 1; });
   is.push_back(fbegin);
 
@@ -220,183 +454,815 @@ void EPSolution::iga_perturb(unsigned dc) {
   insert_all();
 }
 
-unsigned EPSolution::iga(const IGAOptions &opt) {
+unsigned EPSolution::iga(const IGAOptions &opt, Incumbent *inc) {
 
-  unsigned steps = 0;
-  SSolution bs{π, of, run::elapsed()};
+  unsigned steps = 0, last_improvement = 0;
+  SSolution bs{π, of, run::elapsed(), excess};
+  auto &ps = ws.ps;
+  unsigned long allocs0 = 0;
 
   vprint(2, "IGA starts {} {}\n", of, so.of);
   double last_report = run::elapsed();
-  while (!opt.stop(steps)) {
+  while (!opt.stop(steps, bs.excess > 0 ? infinite_time : bs.of)) {
+    if (steps == 1)
+      allocs0 = alloc::count(); // the first iteration sizes the buffers
     vprint(3, "IGA has {} {}\n", of, so.of);
-    SSolution ps{π, of, 0};
+    ps.π = π;
+    ps.of = of;
+    ps.excess = excess;
     iga_perturb(opt.dc);
     shift_ls();
-    if (of < bs.of) {
-      bs = SSolution{π, of, run::elapsed()};
-      Time ft = getFlowtime(I);
+    bool accepted = true;
+    const auto cs = make_pair(excess, of);
+    if (cs < bs.key()) {
+      bs.π = π;
+      bs.of = of;
+      bs.excess = excess;
+      bs.tfound = run::elapsed();
+      Time ft = compute_ms_ft_mo(I, ws.C).second;
       vprint(2, "* {:4.1f} {} {} {}\n", run::elapsed(), of, ft, steps);
       store_so();
       last_report = run::elapsed();
-    } else if (!(of < ps.of || getRandom() < exp(-double(of - ps.of) / opt.T))) {
+      last_improvement = steps;
+      if (inc)
+        inc->offer(bs);
+    } else if (!(cs < ps.key() || (excess == ps.excess && getRandom() < exp(-double(of - ps.of) / opt.T)))) {
       π = ps.π;
       of = ps.of;
+      excess = ps.excess;
+      accepted = false;
+    }
+    if (trace)
+      trace->record(TraceEvent{run::elapsed(), 'I', steps, of, bs.of, insertions, accepted});
+    if (inc && steps - last_improvement >= opt.restart) {
+      auto gs = inc->get();
+      if (gs && gs->key() < make_pair(excess, of)) {
+        π = gs->π;
+        of = gs->of;
+        excess = gs->excess;
+        if (gs->key() < bs.key())
+          bs = *gs;
+      }
+      last_improvement = steps;
     }
     steps++;
     if (verbose(2) && run::elapsed() > last_report + 1) {
       last_report = run::elapsed();
-      Time ft = getFlowtime(I);
+      Time ft = compute_ms_ft_mo(I, ws.C).second;
       fmt::print(". {:4.1f} {} {} {}\n", run::elapsed(), of, ft, steps);
       store_so();
     }
   }
+  allocs = steps > 1 ? alloc::count() - allocs0 : 0;
   π = bs.π;
   of = bs.of;
+  excess = bs.excess;
   tfound = bs.tfound;
   return steps;
 }
 
+bool Incumbent::offer(const SSolution &c) {
+  Time o = of.load(memory_order_relaxed);
+  if (c.excess == 0 && c.of >= o)
+    return false;
+  auto cs = make_shared<const SSolution>(c);
+  auto cur = get();
+  do {
+    if (cur && cur->key() <= c.key())
+      return false;
+  } while (!atomic_compare_exchange_weak(&s, &cur, cs));
+  while (c.excess == 0 && c.of < o && !of.compare_exchange_weak(o, c.of))
+    ;
+  return true;
+}
+
+// run `nt` independent IGA walks from `S`, walk t seeded with `seed+t`, sharing their incumbent
+unsigned parallel_iga(EPSolution &S, const IGAOptions &opt, unsigned nt, unsigned seed) {
+  Incumbent inc;
+  inc.offer(SSolution{S.π, S.of, S.tfound, S.excess});
+
+  vector<EPSolution> W(nt, S);
+  for (auto &Sw : W)
+    Sw.pool = nullptr;
+  vector<unsigned> steps(nt, 0);
+  vector<thread> T;
+  const timer start = run::start;
+  for (unsigned t = 0; t != nt; ++t)
+    T.emplace_back([&, t] {
+      run::start = start;
+      setupRandom(seed + t);
+      steps[t] = W[t].iga(opt, &inc);
+    });
+  for (auto &th : T)
+    th.join();
+
+  auto bs = inc.get();
+  S.π = bs->π;
+  S.of = bs->of;
+  S.excess = bs->excess;
+  S.tfound = bs->tfound;
+  S.allocs = 0;
+  const auto insertions = S.insertions;
+  for (auto &Sw : W) {
+    if (Sw.so.of < S.so.of)
+      S.so = Sw.so;
+    S.allocs += Sw.allocs;
+    S.insertions += Sw.insertions - insertions;
+  }
+  return accumulate(steps.begin(), steps.end(), 0u);
+}
+
 Result EPSolution::getResultPO() {
-  auto [ms, ft] = compute_ms_ft_mo(I);
+  auto [ms, ft] = evaluate();
   return Result{ms, ft, tfound};
 }
 
 Result EPSolution::getResultSO() {
   PSolution Sf{I, so.π};
-  auto [ms, ft] = Sf.compute_ms_ft_mo(I);
+  auto [ms, ft] = of_npsset ? Sf.evaluateNPSset(I) : Sf.compute_ms_ft_mo(I);
   return Result{ms, ft, so.tfound};
 }
 
-bool IGAOptions::stop(unsigned steps) const {
+bool IGAOptions::stop(unsigned steps, Time of) const {
+  if (of <= lb)
+    return true;
   if (iterlimit > 0 && int(steps) > iterlimit)
     return true;
   if (timelimit > 0 && run::elapsed() > timelimit)
     return true;
+  if (cancel && *cancel)
+    return true;
   return false;
 }
 
-void ENPSolution::compute_ρ() {
-  for (auto i = 1u; i <= I.m; ++i)
-    for (auto k = 1u; k <= I.n; ++k)
-      ρ[i][π[i][k]] = k;
-}
+void ENPSolution::compute_ρ() { inverse(ρ); }
 
 void ENPSolution::clear() { fbegin = 1; }
 
+void ENPSolution::move(unsigned i, unsigned from, unsigned to) {
+  auto πi = π[i].begin();
+  if (from < to)
+    rotate(πi + from, πi + from + 1, πi + to + 1);
+  else
+    rotate(πi + to, πi + from, πi + from + 1);
+  for (auto k = std::min(from, to), ke = std::max(from, to); k <= ke; ++k)
+    ρ[i][π[i][k]] = k;
+  if (journaling)
+    journal.push_back(NPShift{i, from, to});
+  if (metrics)
+    mx.moved(i, from, to);
+}
+
+// undo the moves since `push_po` in reverse order
+void ENPSolution::pop_po() {
+  journaling = false;
+  for (auto s = journal.rbegin(); s != journal.rend(); ++s)
+    move(s->i, s->to, s->from);
+  journal.clear();
+  fbegin = fbegin₀;
+  of = of₀;
+  excess = excess₀;
+  if (metrics)
+    update_metrics();
+}
+
 struct NPMove {
   unsigned k;
   int i;
   Time Csum, Cmax;
+  unsigned excess; // over the buffer limit
+  unsigned peak;   // waiting jobs, if breaking ties by them
 
-  void update(const NPMove &cm) {
-    if (cm.Csum < Csum || (cm.Csum == Csum && cm.Cmax < Cmax)) {
+  void update(const NPMove &cm, bool makespan) {
+    auto key = [makespan](const NPMove &v) { return makespan ? tie(v.excess, v.Cmax, v.peak, v.Csum) : tie(v.excess, v.Csum, v.peak, v.Cmax); };
+    if (key(cm) < key(*this))
       *this = cm;
-    }
   }
 };
 
+void NPTimes::compute(const Instance &I, const ENPSolution &S) {
+  if (Cj.shape()[0] != I.m + 1 || Cj.shape()[1] != I.n + 1) {
+    Cj.resize(boost::extents[I.m + 1][I.n + 1]);
+    Ci.resize(boost::extents[I.m + 1][I.n + 1]);
+  }
+  fill(Cj.data(), Cj.data() + Cj.num_elements(), 0);
+  ke = S.fbegin;
+  for (unsigned i = 1; i <= I.m; ++i) {
+    Time C = 0;
+    Ci[i][0] = 0;
+    for (unsigned k = 1; k != ke; ++k) {
+      const auto j = S.π[i][k];
+      Cj[i][j] = Cj[i - 1][j];
+      if (I.pm[i][j] > 0)
+        C = Cj[i][j] = max(C, Cj[i][j]) + I.pm[i][j];
+      Ci[i][k] = C;
+    }
+  }
+  ft = accumulate(Cj[I.m].begin() + 1, Cj[I.m].end(), Time(0));
+}
+
+// tails of the positions before `ke`, like `compute` backwards
+void NPTimes::compute_tails(const Instance &I, const ENPSolution &S) {
+  if (Tj.shape()[0] != I.m + 2 || Tj.shape()[1] != I.n + 1) {
+    Tj.resize(boost::extents[I.m + 2][I.n + 1]);
+    Ti.resize(boost::extents[I.m + 1][I.n + 2]);
+  }
+  fill(Tj[I.m + 1].begin(), Tj[I.m + 1].end(), 0);
+  for (unsigned i = I.m; i >= 1; --i) {
+    Time T = 0;
+    Ti[i][ke] = 0;
+    for (unsigned k = ke - 1; k != 0; --k) {
+      const auto j = S.π[i][k];
+      Tj[i][j] = Tj[i + 1][j];
+      if (I.pm[i][j] > 0)
+        T = Tj[i][j] = max(T, Tj[i][j]) + I.pm[i][j];
+      Ti[i][k] = T;
+    }
+  }
+}
+
+// recompute after the jobs at positions `k` and `k+1` of machine `l` have been exchanged: on each
+// machine only the positions from the first job with a changed input are re-simulated, until the
+// machine's completion time agrees again with the cached one, and we stop when no job changed
+void NPTimes::update(const Instance &I, const ENPSolution &S, unsigned l, unsigned k) {
+  unsigned lo = k, hi = k + 1;
+  D.clear();
+  changed.clear();
+  for (unsigned i = l; i <= I.m; ++i) {
+    if (i > l) {
+      if (D.empty())
+        break;
+      lo = ke, hi = 0;
+      for (auto j : D) {
+        lo = std::min(lo, S.ρ[i][j]);
+        hi = std::max(hi, S.ρ[i][j]);
+      }
+    }
+    Dn.clear();
+    Time C = Ci[i][lo - 1];
+    for (unsigned q = lo; q != ke; ++q) {
+      const auto j = S.π[i][q];
+      Time c = Cj[i - 1][j];
+      if (I.pm[i][j] > 0)
+        C = c = max(C, c) + I.pm[i][j];
+      if (c != Cj[i][j]) {
+        if (i == I.m)
+          ft = ft - Cj[i][j] + c;
+        Cj[i][j] = c;
+        Dn.push_back(j);
+        if (track)
+          changed.push_back({i, j});
+      }
+      if (q > hi && C == Ci[i][q])
+        break;
+      Ci[i][q] = C;
+    }
+    D.swap(Dn);
+  }
+}
+
+void NPTimes::update(const Instance &I, const ENPSolution &S, const vector<unsigned> &lo, const vector<unsigned> &hi) {
+  D.clear();
+  changed.clear();
+  for (unsigned i = 1; i <= I.m; ++i) {
+    unsigned b = lo[i], e = hi[i];
+    for (auto j : D) {
+      b = std::min(b, S.ρ[i][j]);
+      e = std::max(e, S.ρ[i][j]);
+    }
+    Dn.clear();
+    Time C = b <= e ? Ci[i][b - 1] : 0;
+    for (unsigned q = b; b <= e && q != ke; ++q) {
+      const auto j = S.π[i][q];
+      Time c = Cj[i - 1][j];
+      if (I.pm[i][j] > 0)
+        C = c = max(C, c) + I.pm[i][j];
+      if (c != Cj[i][j]) {
+        if (i == I.m)
+          ft = ft - Cj[i][j] + c;
+        Cj[i][j] = c;
+        Dn.push_back(j);
+        if (track)
+          changed.push_back({i, j});
+      }
+      if (q > e && C == Ci[i][q])
+        break;
+      Ci[i][q] = C;
+    }
+    D.swap(Dn);
+  }
+}
+
+Time NPTimes::makespan() const {
+  Time ms = 0;
+  for (unsigned i = 1, ie = Ci.shape()[0]; i != ie; ++i)
+    ms = max(ms, Ci[i][ke - 1]);
+  return ms;
+}
+
+// Insert each job at the best position and switch machine, by exchanging it towards the front on one machine after another and
+// updating the completion times incrementally. Used for the flowtime, and for the makespan under a buffer limit.
 void ENPSolution::insert_all_ft() {
-  NPMove bm{0, 0, infinite_time, infinite_time};
+  PROFILE_SCOPE(insert_all_np);
+  NPMove bm;
+  ct.track = track_buffer();
+
+  auto swap_jobs = [&](unsigned l, unsigned k) {
+    ::swap(π[l][k - 1], π[l][k]);
+    ρ[l][π[l][k - 1]] = k - 1;
+    ρ[l][π[l][k]] = k;
+    ct.update(I, *this, l, k - 1);
+    if (ct.track)
+      update_buffer(l, k - 1);
+    PROFILE_EVALUATIONS(1);
+    assert(ct.ft == getFlowtime(I) && ct.makespan() == getMakespan(I));
+  };
+  auto compute = [&]() {
+    ct.compute(I, *this);
+    if (ct.track)
+      compute_buffer();
+  };
+  auto candidate = [&](unsigned k, int i) { return NPMove{k, i, ct.ft, ct.makespan(), buffer_excess(), tie_buffer ? bt.peak() : 0}; };
+  auto rotate_back = [&]() {
+    for (unsigned i = 1; i <= m; ++i) {
+      rotate(π[i].begin() + 1, π[i].begin() + 2, π[i].begin() + fbegin);
+      for (auto k = 1u; k != fbegin; ++k)
+        ρ[i][π[i][k]] = k;
+    }
+    fbegin--;
+  };
 
   for (auto πend = π.shape()[1]; fbegin != πend;) {
-    for (unsigned k = fbegin++; k > 0; --k) {
-      auto [Cmax, Csum] = compute_ms_ft_mo(I);
-      bm.update(NPMove{k, 0, Csum, Cmax});
+    bm = NPMove{0, 0, infinite_time, infinite_time, ~0u, ~0u};
+    fbegin++;
+    compute();
+    for (unsigned k = fbegin - 1; k > 0; --k) {
+      bm.update(candidate(k, 0), of_makespan);
 
       if (k == 1)
         break;
 
       for (unsigned l = m; l != 1; --l) {
-        ::swap(π[l][k - 1], π[l][k]);
-        auto [Cmax, Csum] = compute_ms_ft_mo(I);
-        bm.update(NPMove{k, -int(l), Csum, Cmax});
+        swap_jobs(l, k);
+        bm.update(candidate(k, -int(l)), of_makespan);
       }
-      ::swap(π[1][k - 1], π[1][k]);
+      swap_jobs(1, k);
     }
-    for (unsigned i = 1; i <= m; ++i)
-      rotate(π[i].begin() + 1, π[i].begin() + 2, π[i].begin() + fbegin);
-    fbegin--;
+    rotate_back();
 
-    for (unsigned k = fbegin++; k > 1; --k) {
+    fbegin++;
+    compute();
+    for (unsigned k = fbegin - 1; k > 1; --k) {
       for (unsigned l = 1; l < m; ++l) {
-        ::swap(π[l][k - 1], π[l][k]);
-        auto [Cmax, Csum] = compute_ms_ft_mo(I);
-        bm.update(NPMove{k, int(l + 1), Csum, Cmax});
+        swap_jobs(l, k);
+        bm.update(candidate(k, int(l + 1)), of_makespan);
       }
-      ::swap(π[m][k - 1], π[m][k]);
+      swap_jobs(m, k);
     }
-    for (unsigned i = 1; i <= m; ++i)
-      rotate(π[i].begin() + 1, π[i].begin() + 2, π[i].begin() + fbegin);
-    fbegin--;
+    rotate_back();
 
-    if (bm.i < 0) {
-      for (auto i = 1u; i < unsigned(-bm.i); ++i) {
-        rotate(π[i].begin() + bm.k, π[i].begin() + fbegin, π[i].begin() + fbegin + 1);
-        for (auto k = bm.k; k != fbegin + 1; ++k)
-          ρ[i][π[i][k]] = k;
-      }
-      for (auto i = -unsigned(bm.i); i <= m; ++i) {
-        rotate(π[i].begin() + bm.k - 1, π[i].begin() + fbegin, π[i].begin() + fbegin + 1);
-        for (auto k = bm.k - 1; k != fbegin + 1; ++k)
-          ρ[i][π[i][k]] = k;
+    insert_at(bm.k, bm.i);
+    of = of_makespan ? bm.Cmax : bm.Csum;
+    excess = bm.excess;
+    fbegin++;
+  }
+}
+
+// move the job at `fbegin` to position `k` on all machines, except to `k-1` on machines `-i`... if i<0, and on machines 1...i-1 if i>0
+void ENPSolution::insert_at(unsigned k, int i) {
+  if (i < 0) {
+    for (auto l = 1u; l < unsigned(-i); ++l)
+      move(l, fbegin, k);
+    for (auto l = -unsigned(i); l <= m; ++l)
+      move(l, fbegin, k - 1);
+  } else if (i == 0) {
+    for (auto l = 1u; l <= m; ++l)
+      move(l, fbegin, k);
+  } else {
+    for (auto l = 1u; l < unsigned(i); ++l)
+      move(l, fbegin, k - 1);
+    for (auto l = unsigned(i); l <= m; ++l)
+      move(l, fbegin, k);
+  }
+}
+
+void BufferTracker::reset(const Instance &I) {
+  const Time horizon = I.totalTime() + 1;
+  if (N < horizon) {
+    N = 1;
+    while (N < horizon)
+      N *= 2;
+    t.resize(2 * N);
+    d.resize(N);
+  }
+  fill(t.begin(), t.end(), 0);
+  fill(d.begin(), d.end(), 0);
+  w.resize(I.m + 1, I.n + 1);
+  fill(w.data(), w.data() + w.num_elements(), pair<Time, Time>{0, 0});
+}
+
+void BufferTracker::set(unsigned i, Job j, Time b, Time e) {
+  auto &v = w[i][j];
+  if (v.first == b && v.second == e)
+    return;
+  if (v.first < v.second)
+    add(v.first, v.second, -1);
+  if (b < e)
+    add(b, e, 1);
+  v = {b, e};
+}
+
+void BufferTracker::add(unsigned l, unsigned r, int v) {
+  l += N, r += N;
+  const unsigned l0 = l, r0 = r - 1;
+  for (; l < r; l >>= 1, r >>= 1) {
+    if (l & 1)
+      apply(l++, v);
+    if (r & 1)
+      apply(--r, v);
+  }
+  rebuild(l0);
+  rebuild(r0);
+}
+
+void ENPSolution::buffer_interval(unsigned i, Job j) {
+  const unsigned nm = I.nextOperation(i, j);
+  unsigned q = ρ[i][j] + 1;
+  if (I.pm[i][j] > 0 && nm <= m)
+    while (q < ct.ke && I.pm[i][π[i][q]] == 0)
+      q++;
+  if (I.pm[i][j] == 0 || nm > m || ρ[i][j] >= ct.ke || q >= ct.ke) {
+    bt.set(i, j, 0, 0);
+    return;
+  }
+  const Job nj = π[i][q];
+  const Time S = ct.Cj[nm][j] - I.pm[nm][j];
+  bt.set(i, j, std::min(ct.Cj[i][nj] - I.pm[i][nj], S), S);
+}
+
+void ENPSolution::compute_buffer() {
+  if (bt.N == 0)
+    bt.reset(I);
+  for (unsigned i = 1; i < m; ++i)
+    for (unsigned k = 1; k <= n; ++k)
+      buffer_interval(i, π[i][k]);
+}
+
+unsigned ENPSolution::bufferspace() {
+  ct.compute(I, *this);
+  compute_buffer();
+  return bt.peak();
+}
+
+void NPMetrics::compute(const Instance &I, const ENPSolution &S) {
+  assert(S.fbegin == I.n + 1);
+  const unsigned m = I.m, n = I.n;
+  ct.track = true;
+  ct.compute(I, S);
+  bt.reset(I);
+  π = S.π;
+  nx.resize(m + 1, n + 2);
+  pr.resize(m + 1, n + 2);
+  prev.resize(m + 1, n + 1);
+  arrival.resize(m + 1, n + 1);
+  inv.assign(m + 1, 0);
+  dirty.assign(m + 1, true);
+  lo.assign(m + 1, n + 1);
+  hi.assign(m + 1, 0);
+  for (Job j = 1; j <= n; ++j) {
+    unsigned p = 0;
+    for (unsigned i = 1; i <= m; ++i) {
+      prev[i][j] = p;
+      if (I.pm[i][j] > 0)
+        p = i;
+    }
+    // a job waits for its first operation from time 0, unless it is on machine 1
+    if (I.firstOperation(j) <= m)
+      arrival[I.firstOperation(j)][j] = 0;
+  }
+  for (unsigned i = 1; i <= m; ++i) {
+    nx[i][n + 1] = n + 1;
+    pr[i][0] = 0;
+    positions(I, i, 1, n);
+  }
+  for (unsigned i = 1; i < m; ++i)
+    for (Job j = 1; j <= n; ++j)
+      operation(I, S, i, j);
+  valid = true;
+  recount(I, S);
+}
+
+// after changing positions b..e on machine i: `nx` changes from e down to the last operation before b, `pr` from b up to the
+// first operation after e
+void NPMetrics::positions(const Instance &I, unsigned i, unsigned b, unsigned e) {
+  const unsigned n = I.n;
+  for (unsigned q = e; q >= 1; --q) {
+    const unsigned v = I.pm[i][π[i][q]] > 0 ? q : nx[i][q + 1];
+    if (q < b && nx[i][q] == v)
+      break;
+    nx[i][q] = v;
+  }
+  for (unsigned q = b; q <= n; ++q) {
+    const unsigned v = I.pm[i][π[i][q]] > 0 ? q : pr[i][q - 1];
+    if (q > e && pr[i][q] == v)
+      break;
+    pr[i][q] = v;
+  }
+}
+
+// waiting interval of operation (i,j) and arrival time of job j at its next machine, as in `buffer_interval` and `computeJRI`
+void NPMetrics::operation(const Instance &I, const ENPSolution &S, unsigned i, Job j) {
+  if (I.pm[i][j] == 0)
+    return;
+  const unsigned nm = I.nextOperation(i, j);
+  if (nm > I.m)
+    return;
+  const Time Sj = ct.Cj[nm][j] - I.pm[nm][j];
+  const unsigned q = nx[i][S.ρ[i][j] + 1];
+  Time a;
+  if (q > I.n) {
+    bt.set(i, j, 0, 0);
+    a = ct.Cj[I.lastOperation(j)][j];
+  } else {
+    const Job nj = S.π[i][q];
+    a = std::min(ct.Cj[i][nj] - I.pm[i][nj], Sj);
+    bt.set(i, j, a, Sj);
+  }
+  if (arrival[nm][j] != a) {
+    arrival[nm][j] = a;
+    dirty[nm] = true;
+  }
+}
+
+void NPMetrics::update(const Instance &I, const ENPSolution &S) {
+  assert(valid && S.fbegin == I.n + 1);
+  const unsigned m = I.m;
+  for (unsigned i = 1; i <= m; ++i) {
+    while (lo[i] <= hi[i] && S.π[i][lo[i]] == π[i][lo[i]])
+      lo[i]++;
+    while (lo[i] <= hi[i] && S.π[i][hi[i]] == π[i][hi[i]])
+      hi[i]--;
+    for (unsigned q = lo[i]; q <= hi[i]; ++q)
+      π[i][q] = S.π[i][q];
+  }
+  ct.update(I, S, lo, hi);
+
+  // operations with a new successor
+  for (unsigned i = 1; i <= m; ++i) {
+    if (lo[i] > hi[i])
+      continue;
+    positions(I, i, lo[i], hi[i]);
+    dirty[i] = true;
+    if (i == m)
+      continue;
+    if (const unsigned q = pr[i][lo[i] - 1])
+      operation(I, S, i, π[i][q]);
+    for (unsigned q = lo[i]; q <= hi[i]; ++q)
+      operation(I, S, i, π[i][q]);
+  }
+  // operations whose start or successor's start changed, and all of a job whose last completion changed
+  for (auto [i, j] : ct.changed) {
+    if (I.pm[i][j] == 0)
+      continue;
+    if (const unsigned pi = prev[i][j])
+      operation(I, S, pi, j);
+    if (const unsigned q = pr[i][S.ρ[i][j] - 1])
+      operation(I, S, i, π[i][q]);
+    if (I.nextOperation(i, j) > m)
+      for (auto [k, p] : I.operations(j))
+        operation(I, S, k, j);
+  }
+  lo.assign(m + 1, I.n + 1);
+  hi.assign(m + 1, 0);
+  recount(I, S);
+}
+
+// positions on machine i in the order of arrival, without the first job, like `kendall_tau`
+void NPMetrics::recount(const Instance &I, const ENPSolution &S) {
+  for (unsigned i = 2; i <= I.m; ++i) {
+    if (!dirty[i])
+      continue;
+    order.clear();
+    for (unsigned k = nx[i][1]; k <= I.n; k = nx[i][k + 1])
+      order.push_back(π[i][k]);
+    sort(order.begin(), order.end(), [&](Job a, Job b) { return make_pair(arrival[i][a], S.ρ[i][a]) < make_pair(arrival[i][b], S.ρ[i][b]); });
+    seq.clear();
+    for (unsigned k = 1; k < order.size(); ++k)
+      seq.push_back(S.ρ[i][order[k]]);
+    inv[i] = count_inversions(seq, tmp);
+    dirty[i] = false;
+  }
+}
+
+double NPMetrics::jri(const Instance &I) const {
+  double jri = 0.0;
+  for (unsigned i = 2; i <= I.m; ++i)
+    jri += inv[i];
+  return jri / (I.n * (I.m - 1));
+}
+
+// after exchanging positions `k` and `k+1` on machine `l`: the jobs there, and the job with an operation before them change their
+// successor on `l`; a changed start of an operation changes the interval of its job on its previous machine, and that of its
+// predecessor with an operation on the same machine
+void ENPSolution::update_buffer(unsigned l, unsigned k) {
+  auto previous_job = [&](unsigned i, unsigned q) {
+    while (q > 1 && I.pm[i][π[i][q - 1]] == 0)
+      q--;
+    if (q > 1)
+      buffer_interval(i, π[i][q - 1]);
+  };
+  buffer_interval(l, π[l][k]);
+  buffer_interval(l, π[l][k + 1]);
+  previous_job(l, k);
+  for (auto [i, j] : ct.changed) {
+    if (I.pm[i][j] == 0)
+      continue;
+    for (unsigned pi = i - 1; pi >= 1; --pi)
+      if (I.pm[pi][j] > 0) {
+        buffer_interval(pi, j);
+        break;
       }
-    } else if (bm.i == 0) {
-      for (auto i = 1u; i <= I.m; ++i) {
-        rotate(π[i].begin() + bm.k, π[i].begin() + fbegin, π[i].begin() + fbegin + 1);
-        for (auto k = bm.k; k != fbegin + 1; ++k)
-          ρ[i][π[i][k]] = k;
+    previous_job(i, ρ[i][j]);
+  }
+}
+
+// Same moves as `insert_all_ft`, for the makespan. The makespan of each move is the longest path through the inserted job, from
+// the heads and tails of the other jobs, in O(m); this is exact unless some job passes the inserted one, when it is a lower bound.
+// Ties of the makespan are broken by the idle time, then keep the first move, in the order of `insert_all_ft`.
+void ENPSolution::insert_all_ms() {
+  PROFILE_SCOPE(insert_all_np);
+
+  for (auto πend = π.shape()[1]; fbegin != πend; ++fbegin) {
+    const Job j = π[1][fbegin];
+    ct.compute(I, *this);
+    ct.compute_tails(I, *this);
+
+    unsigned bk = fbegin;
+    int bi = 0;
+    pair<Time, Time> bv{infinite_time, infinite_time};
+
+    // makespan and idle time with job `j` at position `k` on machines 1..l-1, and at position `kl` on machines l..m; the idle time
+    // sums the delay of the next job on each machine, as in `EPSolution::insert_ms_at`, and breaks ties of the makespan. It is
+    // computed only if the makespan is at most that of the best move `bv`, and up to exceeding its idle time.
+    auto makespan_at = [&](unsigned k, unsigned l, unsigned kl) {
+      Time Cmax = 0, Cj = 0, Ik = 0;
+      for (unsigned i = 1; i <= m; ++i) {
+        const unsigned q = i < l ? k : kl;
+        Time Ci = ct.Ci[i][q - 1];
+        if (I.pm[i][j] > 0)
+          Ci = Cj = std::max(Cj, Ci) + I.pm[i][j];
+        Cmax = std::max(Cmax, Ci + ct.Ti[i][q]);
+        if (Cmax > bv.first)
+          break;
       }
-    } else {
-      for (auto i = 1u; i < unsigned(bm.i); ++i) {
-        rotate(π[i].begin() + bm.k - 1, π[i].begin() + fbegin, π[i].begin() + fbegin + 1);
-        for (auto k = bm.k - 1; k != fbegin + 1; ++k)
-          ρ[i][π[i][k]] = k;
+      PROFILE_EVALUATIONS(1);
+      if (Cmax > bv.first)
+        return make_pair(Cmax, Ik);
+      const Time Ip = Cmax == bv.first ? bv.second : infinite_time;
+      Cj = 0;
+      for (unsigned i = 1; i <= m && Ik < Ip; ++i) {
+        const unsigned q = i < l ? k : kl;
+        Time Ci = ct.Ci[i][q - 1];
+        if (I.pm[i][j] > 0)
+          Ci = Cj = std::max(Cj, Ci) + I.pm[i][j];
+        if (q < fbegin) {
+          const Job jq = π[i][q];
+          Ik += (I.pm[i][jq] > 0 ? std::max(Ci, ct.Cj[i - 1][jq]) + I.pm[i][jq] : Ci) - ct.Ci[i][q];
+        } else
+          Ik += Ci - ct.Ci[i][q - 1];
       }
-      for (auto i = unsigned(bm.i); i <= m; ++i) {
-        rotate(π[i].begin() + bm.k, π[i].begin() + fbegin, π[i].begin() + fbegin + 1);
-        for (auto k = bm.k; k != fbegin + 1; ++k)
-          ρ[i][π[i][k]] = k;
+      return make_pair(Cmax, Ik);
+    };
+
+    auto update = [&](unsigned k, int i, pair<Time, Time> v) {
+      if (v < bv) {
+        bv = v;
+        bk = k;
+        bi = i;
       }
+    };
+    for (unsigned k = fbegin; k > 0; --k) {
+      update(k, 0, makespan_at(k, m + 1, k));
+      if (k == 1)
+        continue;
+      for (unsigned l = m; l != 1; --l)
+        update(k, -int(l), makespan_at(k, l, k - 1));
+      for (unsigned l = 2; l <= m; ++l)
+        update(k, int(l), makespan_at(k - 1, l, k));
     }
-    of = bm.Csum;
-    fbegin++;
+    insert_at(bk, bi);
   }
+  ct.compute(I, *this);
+  of = ct.makespan();
 }
 
 void ENPSolution::remove(Job j) {
+  PROFILE_SCOPE(remove_np);
   fbegin--;
-  for (auto i = 1u; i <= I.m; ++i) {
-    for (auto ji = ρ[i][j]; ji != fbegin; ++ji) {
-      π[i][ji] = π[i][ji + 1];
-      ρ[i][π[i][ji]] = ji;
-    }
-    π[i][fbegin] = j;
-    ρ[i][j] = fbegin;
-  }
+  for (auto i = 1u; i <= I.m; ++i)
+    move(i, ρ[i][j], fbegin);
 }
 
 bool ENPSolution::shift_step() {
-  Time of_ = of;
+  const auto of_ = make_pair(excess, of);
   push_po();
   for (auto j = 1u; j <= n; ++j) {
     remove(j);
     insert_all();
     store_so();
   }
-  if (of >= of_)
+  const bool improved = make_pair(excess, of) < of_;
+  if (!improved)
     pop_po();
-  assert(of <= of_);
-  return of < of_;
+  else
+    drop_po();
+  assert(make_pair(excess, of) <= of_);
+  return improved;
 }
 
 unsigned ENPSolution::shift_ls() {
+  if (buffer > 0)
+    excess = bufferspace() > buffer ? bt.peak() - buffer : 0;
+  if (metrics)
+    update_metrics();
   store_so();
   unsigned steps = 0;
-  while (shift_step()) {
+  for (;;) {
+    const bool improved = shift_step();
+    if (trace)
+      trace->record(TraceEvent{run::elapsed(), 'N', steps, of, of, insertions, improved});
+    if (!improved)
+      break;
     tfound = run::elapsed();
     steps++;
     vprint(3, "{}\n", of);
+    if (metrics)
+      vprint(2, "NP {} {} buffer {} JRI {:.4f}\n", steps, of, peak_buffer(), jri());
+    if (limits && limits->stop(0))
+      break;
+  }
+  return steps;
+}
+
+// remove `dc` random jobs from all machines and reinsert them in random order
+void ENPSolution::iga_perturb(unsigned dc) {
+  assert(fbegin == n + 1 && n > dc);
+  sample_floyd(dc, n, removed);
+  shuffle(removed.begin(), removed.end(), rng);
+  for (auto j : removed)
+    remove(j + 1);
+  insert_all();
+}
+
+unsigned ENPSolution::iga(const IGAOptions &opt) {
+  unsigned steps = 0;
+  Matrix<Job> bπ = π, pπ = π;
+  auto bs = make_pair(excess, of), ps = bs;
+  double btfound = tfound;
+
+  // back to the solution `σ` of value `v`
+  auto restore = [&](const Matrix<Job> &σ, pair<unsigned, Time> v) {
+    π = σ;
+    compute_ρ();
+    tie(excess, of) = v;
+    if (metrics) {
+      for (unsigned i = 1; i <= m; ++i)
+        mx.moved(i, 1, n);
+      update_metrics();
+    }
+  };
+
+  limits = &opt;
+  vprint(2, "NP-IGA starts {} {}\n", excess, of);
+  double last_report = run::elapsed();
+  while (!opt.stop(steps, bs.first == 0 ? bs.second : infinite_time)) {
+    pπ = π;
+    ps = make_pair(excess, of);
+    iga_perturb(opt.dc);
+    shift_ls();
+    const auto cs = make_pair(excess, of);
+    bool accepted = true;
+    if (cs < bs) {
+      bπ = π;
+      bs = cs;
+      btfound = run::elapsed();
+      vprint(2, "* {:4.1f} {} {} {}\n", run::elapsed(), of, excess, steps);
+      last_report = run::elapsed();
+    } else if (!(cs < ps || (excess == ps.first && getRandom() < exp(-double(of - ps.second) / opt.T)))) {
+      restore(pπ, ps);
+      accepted = false;
+    }
+    if (trace)
+      trace->record(TraceEvent{run::elapsed(), 'J', steps, of, bs.second, insertions, accepted});
+    steps++;
+    if (verbose(2) && run::elapsed() > last_report + 1) {
+      last_report = run::elapsed();
+      fmt::print(". {:4.1f} {} {} {}\n", run::elapsed(), of, excess, steps);
+    }
   }
+  limits = nullptr;
+  restore(bπ, bs);
+  tfound = btfound;
   return steps;
 }
 
@@ -4,8 +4,15 @@
  */
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <tuple>
+
+#include "holes.hpp"
 #include "logging.hpp"
+#include "pool.hpp"
 #include "solution.hpp"
+#include "trace.hpp"
 
 struct IGAOptions {
   unsigned dc;
@@ -13,18 +20,49 @@ struct IGAOptions {
   int iterlimit;
   double T;
   double alpha;
+  unsigned restart; // iterations without improvement before a parallel walk restarts from the shared incumbent
+  const std::atomic<bool> *cancel; // if set, stop as soon as it becomes true
+  Time lb;                         // lower bound on the objective; stop once the incumbent reaches it
 
-  IGAOptions() : dc(8), timelimit(30), iterlimit(5000), T(0), alpha(0.2353) {}
+  IGAOptions() : dc(8), timelimit(30), iterlimit(5000), T(0), alpha(0.2353), restart(50), cancel(nullptr), lb(0) {}
 
-  bool stop(unsigned steps) const;
+  // stop after `steps` iterations with incumbent value `of`
+  bool stop(unsigned steps, Time of = infinite_time) const;
 };
 
 struct SSolution {
   std::vector<Job> π;
   Time of;
   double tfound;
+  unsigned excess = 0; // over the buffer limit
   SSolution() : of(infinite_time) {}
-  SSolution(std::vector<Job> π, Time of, double tfound) : π(π), of(of), tfound(tfound) {}
+  SSolution(std::vector<Job> π, Time of, double tfound, unsigned excess = 0) : π(π), of(of), tfound(tfound), excess(excess) {}
+  // solutions within the buffer limit first, then by objective
+  std::pair<unsigned, Time> key() const { return {excess, of}; }
+};
+
+// buffers of the search, sized once from the instance, so that the IGA does not allocate in steady state
+struct Workspace {
+  std::vector<Time> C, ftk;        // completion times on the machines, flowtimes of the prefixes
+  std::vector<unsigned> nk;        // number of jobs with some operation in the prefixes
+  std::vector<unsigned> is;        // positions removed by the perturbation
+  SSolution ps;                    // solution before the perturbation
+
+  Workspace(const Instance &I) : C(I.m + 1, 0), ftk(I.n + 1, 0), nk(I.n + 1, 0) {
+    is.reserve(I.n + 1);
+    ps.π.reserve(I.n + 1);
+  }
+};
+
+// best solution shared by parallel IGA walks; published without locks by swapping an immutable snapshot
+struct Incumbent {
+  std::shared_ptr<const SSolution> s;
+  std::atomic<Time> of; // objective of the incumbent once it is within the buffer limit
+
+  Incumbent() : of(infinite_time) {}
+
+  bool offer(const SSolution &);
+  std::shared_ptr<const SSolution> get() const { return std::atomic_load(&s); }
 };
 
 struct EPSolution : public PSolution {
@@ -32,11 +70,27 @@ struct EPSolution : public PSolution {
   const Instance &I;
   boost::multi_array<Time, 2> h, t;
   bool of_makespan;
+  bool of_npsset;            // optimize the NPS-set decoding of the permutation
+  std::vector<NPSState> nps; // decoder states after positions 0,...,fbegin-1
+  NPSState npsc;             // decoder state of the current insertion
+  unsigned buffer = 0;       // limit on the jobs waiting between machines in the NPS-set decoding (0 for none)
+  unsigned excess = 0;       // of the NPS-set decoding over the buffer limit
+  Matrix<Time> st, stc;      // start time of job j on machine i in the decoding of the prefixes and of the current insertion
+  std::vector<std::pair<Job, const Time *>> rows;
+  std::vector<std::tuple<Time, Job, const Time *>> ops;
+  std::vector<std::pair<Time, int>> events;
   double tfound;
   SSolution so;
+  ThreadPool *pool; // if set, scan insertion positions for the makespan in parallel
+  Workspace ws;
+  unsigned long allocs;     // heap allocations of the IGA after its first iteration (when counting allocations)
+  unsigned long insertions = 0; // jobs inserted so far
+  Trace *trace = nullptr;   // if set, record the progress of the local search and the IGA
 
-  EPSolution(const Instance &I) : Base(I), I(I), h(boost::extents[m + 1][n + 1]), t(boost::extents[m + 2][n + 1]), of_makespan(true) {}
-  EPSolution(const Instance &I, const Base &S) : Base(S), I(I), of_makespan(true) {}
+  static constexpr unsigned parallel_min = 128; // minimum number of positions for a parallel scan
+
+  EPSolution(const Instance &I) : Base(I), I(I), h(boost::extents[m + 1][n + 1]), t(boost::extents[m + 2][n + 1]), of_makespan(true), of_npsset(false), pool(nullptr), ws(I), allocs(0) {}
+  EPSolution(const Instance &I, const Base &S) : Base(S), I(I), of_makespan(true), of_npsset(false), pool(nullptr), ws(I), allocs(0) {}
 
   void update_heads(unsigned, unsigned);
   void update_heads_flowtimes(unsigned, unsigned, std::vector<Time> &);
@@ -46,28 +100,135 @@ struct EPSolution : public PSolution {
   Result getResultPO();
   Result getResultSO();
 
+  // makespan and flowtime of the schedule the objective refers to
+  std::pair<Time, Time> evaluate();
+
   void clear();
   void store_so() {
-    auto [ms, ft] = compute_ms_ft_mo(I);
+    auto [ms, ft] = evaluate();
     auto sof = of_makespan ? ft : ms;
-    if (sof < so.of)
-      so = SSolution{π, sof, run::elapsed()};
+    if (sof < so.of) {
+      so.π = π;
+      so.of = sof;
+      so.tfound = run::elapsed();
+    }
   }
   void totalTimeOrder();
   void insert_all() {
-    if (of_makespan)
+    insertions += π.size() - fbegin;
+    if (of_npsset)
+      insert_all_nps();
+    else if (of_makespan)
       insert_all_ms();
     else
       insert_all_ft();
   }
+  Time insert_ms_at(unsigned, unsigned, Time, Time &) const;
+  void insert_ms_parallel(unsigned, unsigned &, Time &, unsigned &);
   void insert_all_ms();
   void insert_all_ft();
+  void update_nps(unsigned, unsigned);
+  unsigned nps_peak(unsigned, unsigned, Job);
+  // peak number of jobs waiting between machines in the NPS-set decoding of the sequence
+  unsigned nps_bufferspace();
+  void insert_all_nps();
   void shuffle_free();
   void remove(unsigned);
   bool shift_step();
   unsigned shift_ls();
   void iga_perturb(unsigned);
-  unsigned iga(const IGAOptions &);
+  unsigned iga(const IGAOptions &, Incumbent * = nullptr);
+};
+
+unsigned parallel_iga(EPSolution &, const IGAOptions &, unsigned, unsigned);
+
+struct ENPSolution;
+
+// completion times of a non-permutation solution, updated incrementally after adjacent swaps
+struct NPTimes {
+  boost::multi_array<Time, 2> Cj; // completion time of job j after machines 1..i
+  boost::multi_array<Time, 2> Ci; // completion time of machine i after positions 1..k
+  boost::multi_array<Time, 2> Tj; // time from the start of job j on machines i..m to the end
+  boost::multi_array<Time, 2> Ti; // time from the start of positions k.. on machine i to the end
+  std::vector<Job> D, Dn;         // jobs with changed completion times on the current and next machine
+  unsigned ke;                    // end of the evaluated positions
+  Time ft;                        // flowtime
+  bool track = false;             // record the changed completion times of `update` in `changed`
+  std::vector<std::pair<unsigned, Job>> changed;
+
+  void compute(const Instance &, const ENPSolution &);
+  void compute_tails(const Instance &, const ENPSolution &);
+  void update(const Instance &, const ENPSolution &, unsigned, unsigned);
+  // after the sequence of each machine i changed at positions lo[i]..hi[i], none if lo[i]>hi[i]
+  void update(const Instance &, const ENPSolution &, const std::vector<unsigned> &lo, const std::vector<unsigned> &hi);
+  Time makespan() const;
+};
+
+// Peak number of jobs waiting between machines. A job waits after its operation on machine i from the start of the next job on
+// machine i until its next operation starts, as in `NPSolution::computeBufferspace`. The waiting intervals are kept per operation
+// in a segment tree over time with range additions, so changing an interval costs O(log T) and the peak is at the root.
+struct BufferTracker {
+  unsigned N = 0;                          // leaves, a power of two larger than the horizon
+  std::vector<int> t, d;                   // maximum and pending addition of the subtrees
+  Matrix<std::pair<Time, Time>> w;         // waiting interval [b,e) after operation (i,j)
+
+  void reset(const Instance &);
+  void set(unsigned i, Job j, Time b, Time e);
+  unsigned peak() const { return t[1]; }
+
+private:
+  void add(unsigned l, unsigned r, int v);
+  void apply(unsigned p, int v) {
+    t[p] += v;
+    if (p < N)
+      d[p] += v;
+  }
+  void rebuild(unsigned p) {
+    while (p > 1) {
+      p >>= 1;
+      t[p] = std::max(t[2 * p], t[2 * p + 1]) + d[p];
+    }
+  }
+};
+
+// Buffer space and JRI of a complete solution, as `computeBufferspace` and `computeJRI`. The positions changed on each machine are
+// recorded by `moved`; `update` narrows them to those that differ from the last update, updates the completion times from there,
+// and recomputes the waiting interval and arrival time only of the operations whose successor or completion times changed.
+// Inversions are recounted on the machines whose sequence or arrival times changed.
+struct NPMetrics {
+  NPTimes ct;                     // completion times of the complete solution
+  BufferTracker bt;
+  Matrix<Job> π;                  // sequences at the last update
+  Matrix<unsigned> nx, pr;        // first position from k on, and last up to k, with an operation on machine i; n+1 or 0 if none
+  Matrix<unsigned> prev;          // machine of the operation of job j before machine i, 0 if none
+  Matrix<Time> arrival;           // time job j enters the buffer of machine i
+  std::vector<unsigned long> inv; // inversions between the arrival and the processing order on machine i
+  std::vector<bool> dirty;        // machines whose inversions must be recounted
+  std::vector<unsigned> lo, hi;   // positions changed on machine i since the last update
+  bool valid = false;             // computed for the current solution, up to the recorded changes
+  std::vector<Job> order;
+  std::vector<unsigned> seq, tmp;
+
+  void moved(unsigned i, unsigned from, unsigned to) {
+    if (!valid)
+      return;
+    lo[i] = std::min({lo[i], from, to});
+    hi[i] = std::max({hi[i], from, to});
+  }
+  void compute(const Instance &, const ENPSolution &);
+  void update(const Instance &, const ENPSolution &);
+  unsigned peak() const { return bt.peak(); }
+  double jri(const Instance &) const;
+
+private:
+  void positions(const Instance &, unsigned i, unsigned b, unsigned e);
+  void operation(const Instance &, const ENPSolution &, unsigned i, Job j);
+  void recount(const Instance &, const ENPSolution &);
+};
+
+// job moved from position `from` to position `to` on machine `i`, shifting the jobs in between
+struct NPShift {
+  unsigned i, from, to;
 };
 
 struct ENPSolution : public NPSolution {
@@ -75,19 +236,39 @@ struct ENPSolution : public NPSolution {
   const Instance &I;
   double tfound;
 
-  boost::multi_array<unsigned, 2> ρ;
-  ENPSolution *S₀;
+  Matrix<unsigned> ρ;
+  NPTimes ct;
 
-  ENPSolution(const Instance &I) : Base(I), I(I), tfound(0.0), ρ(boost::extents[m + 1][n + 1]), S₀(nullptr) { compute_ρ(); }
-  ENPSolution(const Instance &I, const Base &S) : Base(S), I(I), tfound(0.0), ρ(boost::extents[m + 1][n + 1]), S₀(nullptr) { compute_ρ(); }
-  ENPSolution(const Instance &I, const EPSolution &S) : Base(I, PSolution(S)), I(I), tfound(0.0), ρ(boost::extents[m + 1][n + 1]), S₀(nullptr) { compute_ρ(); }
+  // moves since `push_po`, undone by `pop_po`
+  std::vector<NPShift> journal;
+  bool journaling = false;
+  unsigned fbegin₀;
+  Time of₀;
+  unsigned excess₀;
 
-  ENPSolution(ENPSolution &&other) : Base(other), I(other.I) { this->swap(other); }
+  // if positive, limit on the jobs waiting between machines; moves minimize the excess over it first
+  unsigned buffer = 0;
+  unsigned excess = 0;
+  bool tie_buffer = false; // among moves of equal objective, prefer fewer waiting jobs
+  BufferTracker bt;
 
-  ENPSolution(const ENPSolution &other) : Base(other), I(other.I), tfound(other.tfound), S₀(nullptr) {
-    ρ.resize(boost::extents[other.ρ.shape()[0]][other.ρ.shape()[1]]);
-    ρ = other.ρ;
-  }
+  // if set, keep the buffer space and the JRI of the solution after each insertion and undo
+  bool metrics = false;
+  NPMetrics mx;
+
+  std::vector<unsigned> removed; // jobs removed by the perturbation of the IGA, 0-based
+
+  bool of_makespan = false;     // makespan is the primary objective
+  unsigned long insertions = 0; // jobs inserted so far
+  Trace *trace = nullptr;       // if set, record the progress of the local search and the IGA
+  const IGAOptions *limits = nullptr; // if set, the local search stops between steps once they are reached
+
+  ENPSolution(const Instance &I) : Base(I), I(I), tfound(0.0), ρ(m + 1, n + 1) { compute_ρ(); }
+  ENPSolution(const Instance &I, const Base &S) : Base(S), I(I), tfound(0.0), ρ(m + 1, n + 1) { compute_ρ(); }
+  ENPSolution(const Instance &I, const EPSolution &S) : Base(I, PSolution(S)), I(I), tfound(0.0), ρ(m + 1, n + 1), of_makespan(S.of_makespan) { compute_ρ(); }
+
+  ENPSolution(ENPSolution &&other) = default;
+  ENPSolution(const ENPSolution &other) : Base(other), I(other.I), tfound(other.tfound), ρ(other.ρ), buffer(other.buffer), excess(other.excess), tie_buffer(other.tie_buffer), metrics(other.metrics), of_makespan(other.of_makespan), insertions(other.insertions), trace(other.trace), limits(other.limits) {}
 
   ENPSolution &operator=(ENPSolution other) {
     this->swap(other);
@@ -98,25 +279,66 @@ struct ENPSolution : public NPSolution {
     Base::swap(other);
     using std::swap;
     swap(tfound, other.tfound);
-    ρ.resize(boost::extents[other.ρ.shape()[0]][other.ρ.shape()[1]]);
-    swap(ρ, other.ρ);
+    ρ.swap(other.ρ);
+    swap(buffer, other.buffer);
+    swap(excess, other.excess);
+    swap(tie_buffer, other.tie_buffer);
+    swap(metrics, other.metrics);
+    swap(mx, other.mx);
+    swap(of_makespan, other.of_makespan);
+    swap(insertions, other.insertions);
+    swap(trace, other.trace);
+    swap(limits, other.limits);
   }
 
   void compute_ρ();
 
   Result getResultPO();
   void store_so() {}
-  void push_po() { S₀ = new ENPSolution(*this); }
-  void pop_po() {
-    *this = *S₀;
-    delete S₀;
-    S₀ = nullptr;
+  void push_po() {
+    journal.clear();
+    journaling = true;
+    fbegin₀ = fbegin;
+    of₀ = of;
+    excess₀ = excess;
   }
+  void pop_po();
+  void drop_po() { journaling = false; }
+
+  void move(unsigned, unsigned, unsigned);
 
   void clear();
-  void insert_all() { insert_all_ft(); }
+  void insert_all() {
+    insertions += π.shape()[1] - fbegin;
+    if (of_makespan && !track_buffer())
+      insert_all_ms();
+    else
+      insert_all_ft();
+    if (metrics)
+      update_metrics();
+  }
   void insert_all_ft();
+  void insert_all_ms();
+  void insert_at(unsigned, int);
+
+  // waiting intervals of all operations before `ct.ke`, of those affected by the last update of `ct`, and of one operation
+  void compute_buffer();
+  void update_buffer(unsigned, unsigned);
+  void buffer_interval(unsigned, Job);
+  unsigned buffer_excess() const { return buffer > 0 && bt.peak() > buffer ? bt.peak() - buffer : 0; }
+  // peak number of waiting jobs of the positions before `fbegin`
+  unsigned bufferspace();
+  // evaluate the buffer for each move
+  bool track_buffer() const { return buffer > 0 || tie_buffer; }
+
+  // buffer space and JRI of the complete solution; the getters are valid after `update_metrics`
+  void update_metrics() { mx.valid ? mx.update(I, *this) : mx.compute(I, *this); }
+  unsigned peak_buffer() const { return mx.peak(); }
+  double jri() const { return mx.jri(I); }
   void remove(Job);
   bool shift_step();
   unsigned shift_ls();
+  // iterated greedy on the machine sequences of a complete solution; returns the number of iterations
+  void iga_perturb(unsigned);
+  unsigned iga(const IGAOptions &);
 };
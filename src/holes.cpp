@@ -4,51 +4,198 @@
  */
 #include "holes.hpp"
 
+#include <algorithm>
+#include <cassert>
+
 #include "logging.hpp"
 
 using namespace std;
 
-hlist::element hlist::earliest(Time p, Time C) {
-  auto e = h.lower_bound({p, C});
-  auto b = --h.end();
+void hlist::clear() {
+  t.clear();
+  root = free = nil;
+  count = 0;
+  seed = 2463534242u;
+  insert({infinite_time, infinite_time});
+}
+
+hlist::element hlist::make(Interval iv) {
+  element x = free;
+  if (x != nil)
+    free = t[x].l;
+  else {
+    x = t.size();
+    t.push_back({});
+  }
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  t[x] = {iv, iv.p, seed, nil, nil};
+  count++;
+  return x;
+}
+
+void hlist::release(element x) {
+  t[x].iv.p = 0;
+  t[x].l = free;
+  free = x;
+  count--;
+}
 
-  while (e != h.end()) {
-    if (p <= e->duration(C) && e->start() < b->start())
-      b = e;
-    e++;
+// split `x` into holes starting before `s` and the rest
+void hlist::split(element x, Time s, element &a, element &b) {
+  if (x == nil) {
+    a = b = nil;
+  } else if (t[x].iv.start() < s) {
+    split(t[x].r, s, t[x].r, b);
+    a = x;
+    pull(x);
+  } else {
+    split(t[x].l, s, a, t[x].l);
+    b = x;
+    pull(x);
   }
+}
+
+hlist::element hlist::merge(element a, element b) {
+  if (a == nil)
+    return b;
+  if (b == nil)
+    return a;
+  if (t[a].pr > t[b].pr) {
+    t[a].r = merge(t[a].r, b);
+    pull(a);
+    return a;
+  } else {
+    t[b].l = merge(a, t[b].l);
+    pull(b);
+    return b;
+  }
+}
+
+void hlist::insert(Interval iv) {
+  element a, b;
+  split(root, iv.start(), a, b);
+  root = merge(merge(a, make(iv)), b);
+}
+
+// remove the hole starting at `s` from `x`
+hlist::element hlist::erase(element x, Time s) {
+  assert(x != nil);
+  if (t[x].iv.start() == s) {
+    element y = merge(t[x].l, t[x].r);
+    release(x);
+    return y;
+  }
+  if (s < t[x].iv.start())
+    t[x].l = erase(t[x].l, s);
+  else
+    t[x].r = erase(t[x].r, s);
+  pull(x);
+  return x;
+}
+
+// update the maximum lengths on the path to the hole starting at `s`
+void hlist::refresh(element x, Time s) {
+  if (s < t[x].iv.start())
+    refresh(t[x].l, s);
+  else if (s > t[x].iv.start())
+    refresh(t[x].r, s);
+  pull(x);
+}
+
+// leftmost hole in `x` starting after `C` of length at least `p`
+hlist::element hlist::first(element x, Time p, Time C) const {
+  if (x == nil || t[x].ml < p)
+    return nil;
+  if (t[x].iv.start() <= C)
+    return first(t[x].r, p, C);
+  element y = first(t[x].l, p, C);
+  if (y != nil)
+    return y;
+  if (t[x].iv.p >= p)
+    return x;
+  return first(t[x].r, p, C);
+}
+
+// Earliest hole that fits `p` after `C`. Holes are disjoint, so only the last hole starting at or before `C` can contain `C`; if it
+// does not fit, the answer is the first hole starting after `C` which is long enough.
+hlist::element hlist::earliest(Time p, Time C) const {
+  element b = nil;
+  for (element x = root; x != nil;)
+    if (t[x].iv.start() <= C) {
+      b = x;
+      x = t[x].r;
+    } else
+      x = t[x].l;
+  if (b != nil && t[b].iv.f >= C + p)
+    return b;
+  b = first(root, p, C);
+  assert(b != nil);
   return b;
 }
 
-hlist::element hlist::smallest(Time p, Time C) {
-  auto e = h.lower_bound({p, 0});
-  while (e->duration(C) < p)
-    e++;
-  return e;
+hlist::element hlist::smallest(Time p, Time C) const {
+  element b = nil;
+  for (element x = 0, xe = t.size(); x != xe; ++x)
+    if (t[x].iv.p > 0 && t[x].iv.duration(C) >= p && (b == nil || t[x].iv < t[b].iv))
+      b = x;
+  assert(b != nil);
+  return b;
 }
 
 bool hlist::reduce(element e, Time d) {
-  if (e->p <= d) {
-    h.erase(e);
+  if (t[e].iv.p <= d) {
+    root = erase(root, t[e].iv.start());
     return true;
   } else {
-    auto v = *e;
-    h.erase(e);
-    v.p -= d;
-    h.insert(v);
+    t[e].iv.p -= d;
+    refresh(root, t[e].iv.start());
     return false;
   }
 }
 
 void hlist::cut(element e, Time C, Time p) {
-  auto s = e->start();
+  auto s = t[e].iv.start();
   assert(s <= C);
   reduce(e, C + p - s);
   if (s < C)
-    h.insert({C - s, C});
+    insert({C - s, C});
+}
+
+void NPSState::reset() {
+  for (auto &hi : h)
+    hi.clear();
+  ms = ft = 0;
+}
+
+Time NPSState::add(const Instance &I, Job j, bool smallest, Time *start) {
+  Time Ct = 0;
+  for (auto [i, p] : I.operations(j)) {
+    auto &hi = h[i - 1];
+    auto e = smallest ? hi.smallest(p, Ct) : hi.earliest(p, Ct);
+    const auto s = hi[e].start();
+    if (Ct <= s) {
+      hi.reduce(e, p);
+      Ct = s;
+    } else {
+      hi.cut(e, Ct, p);
+    }
+    if (start)
+      start[i] = Ct;
+    Ct += p;
+  }
+  ms = max(ms, Ct);
+  ft += Ct;
+  return Ct;
 }
 
 string hlist::to_string() const {
+  vector<Interval> h;
+  for (auto &x : t)
+    if (x.iv.p > 0)
+      h.push_back(x.iv);
+  sort(h.begin(), h.end(), [](const Interval &i, const Interval &j) { return i.start() < j.start(); });
   string s = "";
   for (auto f : h)
     s += fmt::format("{} ", f);
@@ -5,8 +5,8 @@
 #pragma once
 
 #include <iostream>
-#include <set>
 #include <utility>
+#include <vector>
 
 #include "instance.hpp"
 #include "logging.hpp"
@@ -24,18 +24,63 @@ struct Interval {
 
 template <> struct fmt::formatter<Interval> : ostream_formatter {};
 
+// Disjoint holes of a machine, starting with [0,∞). The holes are kept in a treap ordered by start time, with the maximum
+// hole length of each subtree, in a pool of nodes, so that updates do not allocate once the pool has grown.
 struct hlist {
-  using element = typename std::set<Interval>::iterator;
+  using element = unsigned;
+  static constexpr element nil = ~0u;
 
-  std::set<Interval> h;
+  struct Node {
+    Interval iv;
+    Time ml;     // maximum hole length in the subtree
+    unsigned pr; // heap priority
+    element l, r;
+  };
 
-  hlist() { h.insert({infinite_time, infinite_time}); }
+  std::vector<Node> t;
+  element root, free; // free nodes are linked by `l`
+  unsigned count, seed;
 
-  unsigned size() const { return h.size(); }
-  element earliest(Time p, Time C);
-  element smallest(Time p, Time C);
+  hlist() { clear(); }
+
+  void clear();
+  void reserve(unsigned k) { t.reserve(k); }
+  const Interval &operator[](element e) const { return t[e].iv; }
+  unsigned size() const { return count; }
+  element earliest(Time p, Time C) const;
+  element smallest(Time p, Time C) const;
   bool reduce(element, Time d);
   void cut(element, Time C, Time p);
 
   std::string to_string() const;
+
+private:
+  Time ml(element x) const { return x == nil ? 0 : t[x].ml; }
+  void pull(element x) { t[x].ml = std::max({t[x].iv.p, ml(t[x].l), ml(t[x].r)}); }
+  element make(Interval);
+  void release(element);
+  void split(element, Time, element &, element &);
+  element merge(element, element);
+  void insert(Interval);
+  element erase(element, Time);
+  void refresh(element, Time);
+  element first(element, Time p, Time C) const;
+};
+
+// state of the NPS-set decoder after a sequence of jobs: the holes of each machine, the makespan and the flowtime
+struct NPSState {
+  std::vector<hlist> h;
+  Time ms, ft;
+
+  NPSState(unsigned m = 0) : h(m), ms(0), ft(0) {}
+
+  void reset();
+  // room for the holes left by `n` jobs, so that adding them does not allocate
+  void reserve(unsigned n) {
+    for (auto &hi : h)
+      hi.reserve(n + 2);
+  }
+  // schedule each operation of `j` in the earliest (or smallest) hole after its previous operation, return its completion time;
+  // if given, `start[i]` receives the start time on machine i
+  Time add(const Instance &I, Job j, bool smallest = false, Time *start = nullptr);
 };
@@ -4,6 +4,15 @@
  */
 #include "instance.hpp"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
 #include <set>
 #include <string>
 using namespace std;
@@ -16,19 +25,109 @@ using namespace std;
 
 Instance::Instance(istream &in) { read_hn(in); }
 
+// scans the whole input in place, without allocating per token
 void Instance::read_hn(istream &in) {
-  string t1, t2, t3, t4, tj;
-  in >> t1 >> m >> t2 >> n >> t3 >> t4 >> r;
+  const string s{istreambuf_iterator<char>(in), istreambuf_iterator<char>()};
+  const char *c = s.c_str();
+  auto skip = [&]() {
+    while (*c == ' ' || *c == '\t' || *c == '\n' || *c == '\r')
+      ++c;
+  };
+  auto word = [&](const char *w) {
+    skip();
+    const auto l = strlen(w);
+    const bool ok = strncmp(c, w, l) == 0;
+    c += l;
+    return ok;
+  };
+  auto number = [&]() {
+    skip();
+    unsigned v = 0;
+    for (; *c >= '0' && *c <= '9'; ++c)
+      v = 10 * v + (*c - '0');
+    return v;
+  };
+
+  [[maybe_unused]] bool ok = word("numberMachines");
+  m = number();
+  ok = word("numberJobs") && ok;
+  n = number();
+  ok = word("missing") && word("Operations") && ok;
+  assert(ok);
+  skip();
+  char *e;
+  r = strtod(c, &e);
+  c = e;
   p.resize(boost::extents[n + 1][m + 1]);
-  assert(t1 == "numberMachines" && t2 == "numberJobs" && t3 == "missing" && t4 == "Operations");
   for (auto i = 1u; i <= m; ++i)
     for (auto j = 1u; j <= n; ++j) {
-      in >> tj >> p[j][i];
-      assert(tj == fmt::format("t_{}_{}", i - 1, j - 1));
+      ok = word("t_");
+      [[maybe_unused]] const unsigned ti = number();
+      ok = *c++ == '_' && ok;
+      [[maybe_unused]] const unsigned tj = number();
+      assert(ok && ti == i - 1 && tj == j - 1);
+      p[j][i] = number();
     }
   compute_auxiliary_data();
 }
 
+// binary format: header, then `p` as (n+1)×(m+1) times in row-major order, in host byte order
+struct BinaryHeader {
+  char magic[8];
+  uint32_t n, m;
+  double r;
+};
+static_assert(sizeof(BinaryHeader) == 24);
+static const char binary_magic[8] = {'N', 'P', 'F', 'S', 'M', 'O', 'B', '1'};
+
+bool Instance::is_binary(const string &fname) {
+  char magic[sizeof binary_magic];
+  ifstream in(fname, ios::binary);
+  return in.read(magic, sizeof magic) && memcmp(magic, binary_magic, sizeof magic) == 0;
+}
+
+bool Instance::read_binary(const string &fname) {
+  const int fd = open(fname.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  void *data = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(BinaryHeader))
+    data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+
+  BinaryHeader h;
+  memcpy(&h, data, sizeof h);
+  const size_t np = size_t(h.n + 1) * (h.m + 1);
+  const bool ok = memcmp(h.magic, binary_magic, sizeof binary_magic) == 0 && size_t(st.st_size) == sizeof h + np * sizeof(Time);
+  if (ok) {
+    n = h.n;
+    m = h.m;
+    r = h.r;
+    p.resize(boost::extents[n + 1][m + 1]);
+    memcpy(p.data(), static_cast<const char *>(data) + sizeof h, np * sizeof(Time));
+    compute_auxiliary_data();
+  }
+  munmap(data, st.st_size);
+  return ok;
+}
+
+void Instance::write_binary(ostream &out) const {
+  BinaryHeader h;
+  memcpy(h.magic, binary_magic, sizeof binary_magic);
+  h.n = n;
+  h.m = m;
+  h.r = r;
+  out.write(reinterpret_cast<const char *>(&h), sizeof h);
+  for (unsigned j = 0; j <= n; ++j)
+    for (unsigned i = 0; i <= m; ++i) {
+      const Time t = p[j][i];
+      out.write(reinterpret_cast<const char *>(&t), sizeof t);
+    }
+}
+
 void Instance::reverse() {
   for (auto i = 1u; i != m / 2; ++i)
     for (auto j = 1u; j != n; ++j)
@@ -37,11 +136,26 @@ void Instance::reverse() {
 }
 
 void Instance::compute_auxiliary_data() {
-  oeff = 0;
-  for (unsigned j = 1; j <= n; ++j)
-    for (unsigned i = 1; i <= m; ++i)
+  pm.resize(boost::extents[m + 1][n + 1]);
+  no.resize(boost::extents[n + 1][m + 1]);
+  ob.assign(n + 2, 0);
+  ops.clear();
+  for (unsigned j = 1; j <= n; ++j) {
+    ob[j] = ops.size();
+    for (unsigned i = 1; i <= m; ++i) {
+      pm[i][j] = p[j][i];
       if (p[j][i] != 0)
-        ++oeff;
+        ops.push_back({i, p[j][i]});
+    }
+    unsigned o = m + 1;
+    for (unsigned i = m + 1; i-- > 0;) {
+      no[j][i] = o;
+      if (i > 0 && p[j][i] != 0)
+        o = i;
+    }
+  }
+  ob[n + 1] = ops.size();
+  oeff = ops.size();
 }
 
 vector<Time> Instance::totalTimes() const {
@@ -80,24 +194,46 @@ void compute_inverse(const vector<Job> &π, vector<Job> &π⁻) {
     π⁻[π[k]] = k;
 }
 
+// merge sort of s[b..e) using `t` as buffer, counting the inversions
+static unsigned long merge_inversions(vector<unsigned> &s, vector<unsigned> &t, size_t b, size_t e) {
+  if (e - b < 2)
+    return 0;
+  const size_t h = b + (e - b) / 2;
+  unsigned long c = merge_inversions(s, t, b, h) + merge_inversions(s, t, h, e);
+  size_t l = b, r = h, o = b;
+  while (l != h && r != e)
+    if (s[r] < s[l]) {
+      c += h - l;
+      t[o++] = s[r++];
+    } else
+      t[o++] = s[l++];
+  copy(s.begin() + l, s.begin() + h, t.begin() + o);
+  copy(s.begin() + r, s.begin() + e, t.begin() + o + (h - l));
+  copy(t.begin() + b, t.begin() + e, s.begin() + b);
+  return c;
+}
+
+unsigned long count_inversions(vector<unsigned> &s) {
+  vector<unsigned> t(s.size());
+  return merge_inversions(s, t, 0, s.size());
+}
+
+unsigned long count_inversions(vector<unsigned> &s, vector<unsigned> &t) {
+  t.resize(s.size());
+  return merge_inversions(s, t, 0, s.size());
+}
+
 unsigned kendall_tau(const vector<Job> &π, const vector<Job> &σ) {
   assert(set(π.begin(), π.end()) == set(σ.begin(), σ.end()));
   if (π.size() == 0)
     return 0;
 
-  vector<Job> π⁻, σ⁻;
-  compute_inverse(π, π⁻);
+  vector<Job> σ⁻;
   compute_inverse(σ, σ⁻);
 
-  const unsigned ke = π.size();
-  unsigned kt = 0;
-  for (unsigned k1 = 1; k1 != ke; ++k1) {
-    const Job j1 = π[k1];
-    for (unsigned k2 = k1 + 1; k2 != ke; ++k2) {
-      const Job j2 = π[k2];
-      if ((π⁻[j1] < π⁻[j2] && σ⁻[j1] > σ⁻[j2]) || (π⁻[j1] > π⁻[j2] && σ⁻[j1] < σ⁻[j2]))
-        kt++;
-    }
-  }
-  return kt;
+  // positions in σ in the order of π
+  vector<unsigned> s(π.size() - 1);
+  for (unsigned k = 1, ke = π.size(); k != ke; ++k)
+    s[k - 1] = σ⁻[π[k]];
+  return count_inversions(s);
 }
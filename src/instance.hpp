@@ -5,6 +5,7 @@
 #pragma once
 
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "boost/multi_array.hpp"
@@ -14,6 +15,19 @@ using Time = uint32_t;
 const Time infinite_time = std::numeric_limits<int32_t>::max();
 const Time uinf = std::numeric_limits<unsigned>::max();
 
+// effective operation of a job on machine `i`
+struct Operation {
+  unsigned i;
+  Time p;
+};
+
+struct Operations {
+  const Operation *b, *e;
+  const Operation *begin() const { return b; }
+  const Operation *end() const { return e; }
+  unsigned size() const { return e - b; }
+};
+
 struct Instance {
   unsigned n;                    // number of jobs
   unsigned m;                    // number of machines
@@ -21,6 +35,12 @@ struct Instance {
   unsigned oeff;                 // number of effective operations
   boost::multi_array<Time, 2> p; // processing times, job j=1:n, machine i=1:m+1
 
+  // auxiliary layouts, built by `compute_auxiliary_data`
+  boost::multi_array<Time, 2> pm;     // processing times machine-major, machine i=1:m, job j=1:n
+  std::vector<Operation> ops;         // effective operations of all jobs, job by job, in machine order
+  std::vector<unsigned> ob;           // effective operations of job j are ops[ob[j]..ob[j+1])
+  boost::multi_array<unsigned, 2> no; // next effective machine of job j after machine i=0:m, m+1 if none
+
   Instance(unsigned n = 0, unsigned m = 0) : n(n), m(m), p(boost::extents[n + 1][m + 2]) {}
 
   // create from input stream
@@ -29,6 +49,11 @@ struct Instance {
   // read from stream (Henneberg & Neufeld's format)
   void read_hn(std::istream &in);
 
+  // binary format, written by `write_binary` and read through a memory map; `read_binary` returns false if the file is not one
+  static bool is_binary(const std::string &fname);
+  bool read_binary(const std::string &fname);
+  void write_binary(std::ostream &out) const;
+
   // reverse job order
   void reverse();
 
@@ -41,24 +66,16 @@ struct Instance {
   unsigned numEffectiveOperations() const { return oeff; }
   unsigned numPseudojobs() const;
 
-  unsigned firstOperation(Job j) const {
-    unsigned o = 1;
-    while (o <= m && p[j][o] == 0)
-      ++o;
-    return o;
-  }
-  unsigned nextOperation(unsigned i, Job j) const {
-    unsigned o = i + 1;
-    while (o <= m && p[j][o] == 0)
-      ++o;
-    return o;
-  }
-  unsigned lastOperation(Job j) const {
-    unsigned o = m;
-    while (p[j][o] == 0 && o > 0)
-      --o;
-    return o;
-  }
+  Operations operations(Job j) const { return {ops.data() + ob[j], ops.data() + ob[j + 1]}; }
+
+  unsigned firstOperation(Job j) const { return no[j][0]; }
+  unsigned nextOperation(unsigned i, Job j) const { return no[j][i]; }
+  unsigned lastOperation(Job j) const { return ob[j] != ob[j + 1] ? ops[ob[j + 1] - 1].i : 0; }
 };
 
+// number of pairs i<j with s[i]>s[j], in O(n log n); sorts `s`
+unsigned long count_inversions(std::vector<unsigned> &s);
+// same, with buffer `t`, which does not allocate if it has the size of `s`
+unsigned long count_inversions(std::vector<unsigned> &s, std::vector<unsigned> &t);
+// Kendall tau distance of the 1-based permutations π and σ of the same jobs, in O(n log n)
 unsigned kendall_tau(const std::vector<Job> &, const std::vector<Job> &);
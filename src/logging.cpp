@@ -5,6 +5,6 @@
 #include "logging.hpp"
 
 namespace run {
-timer start;
+thread_local timer start;
 options_counter verbosec;
 } // namespace run
@@ -27,7 +27,7 @@ inline void validate(boost::any &v, std::vector<std::string> const &xs, options_
 }
 
 namespace run {
-extern timer start;
+extern thread_local timer start; // per thread, so that instances solved concurrently have their own clock
 extern options_counter verbosec;
 inline double elapsed() { return start.elapsed(); }
 } // namespace run
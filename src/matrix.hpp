@@ -0,0 +1,47 @@
+/**
+ * \file matrix.hpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ *
+ * Dense row-major matrix in a single owning buffer.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// indexed like a two-dimensional `boost::multi_array`, but moves and swaps in O(1)
+template <typename T> struct Matrix {
+  template <typename U> struct Row {
+    U *p;
+    std::size_t c;
+    U &operator[](std::size_t k) const { return p[k]; }
+    U *begin() const { return p; }
+    U *end() const { return p + c; }
+  };
+
+  std::vector<T> a;
+  std::array<std::size_t, 2> ext; // rows, columns
+
+  Matrix() : ext{0, 0} {}
+  Matrix(std::size_t r, std::size_t c, const T &v = T()) : a(r * c, v), ext{r, c} {}
+
+  // resize to `r`×`c`, resetting all elements
+  void resize(std::size_t r, std::size_t c, const T &v = T()) {
+    a.assign(r * c, v);
+    ext = {r, c};
+  }
+
+  const std::size_t *shape() const { return ext.data(); }
+  std::size_t num_elements() const { return a.size(); }
+  T *data() { return a.data(); }
+  const T *data() const { return a.data(); }
+
+  Row<T> operator[](std::size_t i) { return {a.data() + i * ext[1], ext[1]}; }
+  Row<const T> operator[](std::size_t i) const { return {a.data() + i * ext[1], ext[1]}; }
+
+  void swap(Matrix &other) {
+    a.swap(other.a);
+    std::swap(ext, other.ext);
+  }
+};
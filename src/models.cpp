@@ -6,7 +6,9 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <algorithm>
 #include <iostream>
+#include <numeric>
 using namespace std;
 
 #include "logging.hpp"
@@ -21,62 +23,153 @@ void setupSolver(IloCplex solver, const ModelOptions &m) {
     solver.setOut(env.getNullStream());
     solver.setWarning(env.getNullStream());
   }
-  solver.setParam(IloCplex::Param::Threads, 1);
+  solver.setParam(IloCplex::Param::Threads, int(m.threads));
   solver.setParam(IloCplex::Param::TimeLimit, m.timelimit);
 }
 
-void MPFSMO::addVars() {
+void SharedSolution::offer(const NPSolution &Sn) {
+  lock_guard<mutex> lock(mx);
+  if (Sn.of < S.of) {
+    S = Sn;
+    fresh = true;
+  }
+}
+
+bool SharedSolution::take(NPSolution &Sn) {
+  lock_guard<mutex> lock(mx);
+  if (!fresh)
+    return false;
+  Sn = S;
+  fresh = false;
+  return true;
+}
+
+namespace {
+// offers the solutions of a concurrent heuristic to CPLEX, if better than its incumbent
+class HeuristicInjector : public IloCplex::HeuristicCallbackI {
+  const MPFSMO &M;
+  SharedSolution &shared;
+
+public:
+  HeuristicInjector(IloEnv env, const MPFSMO &M, SharedSolution &shared) : IloCplex::HeuristicCallbackI(env), M(M), shared(shared) {}
+
+  IloCplex::CallbackI *duplicateCallback() const { return new (getEnv()) HeuristicInjector(*this); }
+
+  void main() {
+    NPSolution S(M.I);
+    if (!shared.take(S))
+      return;
+    IloNumArray v(getEnv(), M.vars.getSize());
+    const double of = M.values(S, v);
+    if (!hasIncumbent() || of < getIncumbentObjValue()) {
+      vprint(2, "Injecting solution with flowtime {}.\n", S.of);
+      setSolution(M.vars, v, of);
+    }
+    v.end();
+  }
+};
+} // namespace
+
+void MPFSMO::addVars(Time F) {
+  pos.resize(I.m, I.n);
+  nk.assign(I.m, 0);
+  xoff.assign(I.m + 1, 0);
+  koff.assign(I.m + 1, 0);
+  K.clear();
+  for (unsigned i = 0u; i != I.m; ++i) {
+    koff[i] = K.size();
+    for (unsigned j = 0u; j != I.n; ++j)
+      if (I.p[j + 1][i + 1] > 0) {
+        pos[i][j] = nk[i]++;
+        K.push_back(j);
+      } else
+        pos[i][j] = none;
+    xoff[i + 1] = xoff[i] + nk[i] * (nk[i] - 1) / 2;
+  }
+  koff[I.m] = K.size();
+
+  // operation (i,j) completes after the operations of j before i and leaves time for those after it within the horizon of j: the
+  // total processing time bounds the makespan of a semi-active schedule, and a flowtime of at most `F` the completion of j by
+  // F minus the processing times of the other jobs
   const auto Csum = I.totalTime();
+  vector<Time> r(I.n, 0), q(I.n, 0), H(I.n, Csum);
+  for (unsigned j = 0u; j != I.n; ++j)
+    for (auto [i, p] : I.operations(j + 1))
+      q[j] += p;
+  const Time Q = accumulate(q.begin(), q.end(), Time(0));
+  if (F != infinite_time)
+    for (unsigned j = 0u; j != I.n; ++j)
+      H[j] = std::min(H[j], F + q[j] > Q ? F + q[j] - Q : Time(0));
   for (unsigned i = 0u; i != I.m; ++i)
     for (unsigned j = 0u; j != I.n; ++j) {
-      C.add(IloNumVar(env, I.p[j + 1][i + 1], IloInfinity, ILOFLOAT));
-      C[C.getSize() - 1].setName(fmt::format("C[{},{}]", i + 1, j + 1).c_str());
-      obj.setLinearCoef(C[C.getSize() - 1], 1.0 / (Csum * Csum));
+      const Time pij = I.p[j + 1][i + 1];
+      if (pij > 0) {
+        r[j] += pij;
+        q[j] -= pij;
+        C.add(IloNumVar(env, r[j], std::max(H[j], r[j] + q[j]) - q[j], ILOFLOAT));
+      } else
+        C.add(IloNumVar(env, 0.0, 0.0, ILOFLOAT));
+      obj.setLinearCoef(C[ci(i, j)], 1.0 / (Csum * Csum));
     }
-  idx_c = C.getSize();
+  idx_c = I.m * I.n;
   C.add(IloNumVar(env, 0.0, IloInfinity, ILOFLOAT));
-  C[idx_c].setName("Csum");
   obj.setLinearCoef(C[idx_c], 1.0);
 
-  for (unsigned i = 0u; i != I.m; ++i)
-    for (unsigned j1 = 0; j1 != I.n; ++j1)
-      for (unsigned j2 = 0; j2 != I.n; ++j2)
-        if (j1 != j2) {
-          x.add(IloNumVar(env, 0.0, 1.0, ILOINT));
-          x[x.getSize() - 1].setName(fmt::format("x[{},{},{}]", i + 1, j1 + 1, j2 + 1).c_str());
-          idx[{i, j1, j2}] = x.getSize() - 1;
-        }
+  x = IloNumVarArray(env, xoff[I.m], 0.0, 1.0, ILOINT);
+  vars.add(C);
+  vars.add(x);
+
+  if (m.exportModel) {
+    for (unsigned i = 0u; i != I.m; ++i)
+      for (unsigned j = 0u; j != I.n; ++j)
+        C[ci(i, j)].setName(fmt::format("C[{},{}]", i + 1, j + 1).c_str());
+    C[idx_c].setName("Csum");
+    for (unsigned i = 0u; i != I.m; ++i)
+      for (unsigned a = 0; a != nk[i]; ++a)
+        for (unsigned b = a + 1; b != nk[i]; ++b)
+          x[xi(i, a, b)].setName(fmt::format("x[{},{},{}]", i + 1, K[koff[i] + a] + 1, K[koff[i] + b] + 1).c_str());
+  }
 }
 
-void MPFSMO::addCompletion(Time ub_cmax) {
+void MPFSMO::addCompletion() {
   IloRangeArray completion(env);
   int back = -1;
   for (unsigned i = 0; i != I.m; ++i) {
-    unsigned mach = i;
-    for (unsigned j = 0; j != I.n; ++j) {
-      Time pij = I.p[j + 1][i + 1];
-      if (pij == 0)
-        continue;
-      const double Mij = ub_cmax;
-
-      for (unsigned j2 = 0; j2 != I.n; j2++) {
-        if (j2 == j)
-          continue;
-        completion.add(IloRange(env, -Mij + pij, IloInfinity, fmt::format("C{}{}a", i + 1, j + 1).c_str()));
+    // disjunctive pairs; each big-M is the largest slack its row must absorb when inactive, from the bounds of the completion times
+    for (unsigned a = 0; a != nk[i]; ++a) {
+      const unsigned j1 = K[koff[i] + a];
+      const Time p1 = I.p[j1 + 1][i + 1];
+      for (unsigned b = a + 1; b != nk[i]; ++b) {
+        const unsigned j2 = K[koff[i] + b];
+        const Time p2 = I.p[j2 + 1][i + 1];
+        const double M12 = C[ci(i, j1)].getUB() - C[ci(i, j2)].getLB() + p2;
+        const double M21 = C[ci(i, j2)].getUB() - C[ci(i, j1)].getLB() + p1;
+        const auto k = xi(i, a, b);
+
+        completion.add(IloRange(env, p2 - M12, IloInfinity));
         back++;
-        completion[back].setLinearCoef(C[i * I.n + j], 1.0);
-        completion[back].setLinearCoef(C[i * I.n + j2], -1.0);
-        completion[back].setLinearCoef(x[idx[{mach, j2, j}]], -Mij);
+        completion[back].setLinearCoef(C[ci(i, j2)], 1.0);
+        completion[back].setLinearCoef(C[ci(i, j1)], -1.0);
+        completion[back].setLinearCoef(x[k], -M12);
+
+        completion.add(IloRange(env, p1, IloInfinity));
+        back++;
+        completion[back].setLinearCoef(C[ci(i, j1)], 1.0);
+        completion[back].setLinearCoef(C[ci(i, j2)], -1.0);
+        completion[back].setLinearCoef(x[k], M21);
       }
+    }
 
+    for (unsigned a = 0; a != nk[i]; ++a) {
+      const unsigned j = K[koff[i] + a];
       unsigned i2 = i;
       while (i2 > 0) {
         i2--;
         if (I.p[j + 1][i2 + 1] > 0) {
-          completion.add(IloRange(env, pij, IloInfinity, fmt::format("C{}{}b", i + 1, j + 1).c_str()));
+          completion.add(IloRange(env, I.p[j + 1][i + 1], IloInfinity));
           back++;
-          completion[back].setLinearCoef(C[i * I.n + j], 1.0);
-          completion[back].setLinearCoef(C[i2 * I.n + j], -1.0);
+          completion[back].setLinearCoef(C[ci(i, j)], 1.0);
+          completion[back].setLinearCoef(C[ci(i2, j)], -1.0);
           break;
         }
       }
@@ -90,66 +183,63 @@ void MPFSMO::addCompletion(Time ub_cmax) {
     int i = I.lastOperation(j + 1);
     if (i-- == 0)
       continue;
-    completion[back].setLinearCoef(C[i * I.n + j], -1.0);
+    completion[back].setLinearCoef(C[ci(i, j)], -1.0);
   }
 
   model.add(completion);
 }
 
-void MPFSMO::addPrecedences() {
-  IloRangeArray precedences(env);
-  int back = -1;
-
-  for (unsigned i = 0u; i != I.m; ++i)
-    for (unsigned j1 = 0; j1 != I.n; ++j1)
-      for (unsigned j2 = j1 + 1; j2 != I.n; ++j2) {
-        precedences.add(IloRange(env, 1.0, 1.0, fmt::format("P{}{}", j1 + 1, j2 + 1).c_str()));
-        back++;
-        precedences[back].setLinearCoef(x[idx[{i, j1, j2}]], 1.0);
-        precedences[back].setLinearCoef(x[idx[{i, j2, j1}]], 1.0);
-      }
-
-  model.add(precedences);
-}
-
-void MPFSMO::build(Time ub_cmax) {
-  if (ub_cmax == infinite_time)
-    ub_cmax = I.totalTime();
-  addVars();
-  addCompletion(ub_cmax);
-  addPrecedences();
+void MPFSMO::build(Time ub_ft) {
+  addVars(ub_ft);
+  addCompletion();
 }
 
 void MPFSMO::setSolution(IloCplex solver, const PSolution &S) {
   IloNumArray v(env, x.getSize());
-  for (unsigned i = 0, ie = x.getSize(); i != ie; ++i)
-    v[i] = 0.0;
-  const auto ie = S.π.size();
-
-  for (auto i1 = 1u; i1 != ie; ++i1)
-    for (auto i2 = i1 + 1; i2 != ie; ++i2) {
-      auto j1 = S.π[i1] - 1;
-      auto j2 = S.π[i2] - 1;
-      for (unsigned i = 0u; i != I.m; ++i)
-        v[idx[{i, j1, j2}]] = 1.0;
-    }
+  vector<unsigned> rank(I.n);
+  for (auto k = 1u; k != S.π.size(); ++k)
+    rank[S.π[k] - 1] = k;
+
+  for (unsigned i = 0u; i != I.m; ++i)
+    for (unsigned a = 0; a != nk[i]; ++a)
+      for (unsigned b = a + 1; b != nk[i]; ++b)
+        v[xi(i, a, b)] = rank[K[koff[i] + a]] < rank[K[koff[i] + b]];
   solver.addMIPStart(x, v);
   v.end();
 }
 
-void MPFSMO::setSolution(IloCplex solver, const NPSolution &S) {
-  IloNumArray v(env, x.getSize());
-  for (unsigned i = 0, ie = x.getSize(); i != ie; ++i)
-    v[i] = 0.0;
+double MPFSMO::values(const NPSolution &S, IloNumArray &v) const {
+  assert(v.getSize() == vars.getSize());
+  boost::multi_array<Time, 2> Cs(boost::extents[I.m + 1][I.n + 1]);
+  S.compute_completion_times(I, Cs);
+  const auto Csum = I.totalTime();
+  double of = 0.0;
+  Time ft = 0;
+  for (unsigned i = 0u; i != I.m; ++i)
+    for (unsigned j = 0u; j != I.n; ++j) {
+      v[ci(i, j)] = I.p[j + 1][i + 1] > 0 ? Cs[i + 1][j + 1] : 0;
+      of += v[ci(i, j)] / (Csum * Csum);
+    }
+  for (unsigned j = 0; j != I.n; ++j)
+    if (auto i = I.lastOperation(j + 1))
+      ft += Cs[i][j + 1];
+  v[idx_c] = ft;
+  of += ft;
 
+  Matrix<unsigned> ρ;
+  S.inverse(ρ);
+  const unsigned x0 = idx_c + 1;
   for (unsigned i = 0u; i != I.m; ++i)
-    for (auto i1 = 1u; i1 <= I.n; ++i1)
-      for (auto i2 = i1 + 1; i2 <= I.n; ++i2) {
-        auto j1 = S.π[i + 1][i1] - 1;
-        auto j2 = S.π[i + 1][i2] - 1;
-        v[idx[{i, j1, j2}]] = 1.0;
-      }
-  solver.addMIPStart(x, v);
+    for (unsigned a = 0; a != nk[i]; ++a)
+      for (unsigned b = a + 1; b != nk[i]; ++b)
+        v[x0 + xi(i, a, b)] = ρ[i + 1][K[koff[i] + a] + 1] < ρ[i + 1][K[koff[i] + b] + 1];
+  return of;
+}
+
+void MPFSMO::setSolution(IloCplex solver, const NPSolution &S) {
+  IloNumArray v(env, vars.getSize());
+  values(S, v);
+  solver.addMIPStart(vars, v);
   v.end();
 }
 
@@ -157,13 +247,16 @@ NPSolution MPFSMO::getSolution(IloCplex solver) {
   IloNumArray value(env);
   solver.getValues(x, value);
   NPSolution S(I);
+  vector<unsigned> π;
   for (unsigned i = 0u; i != I.m; ++i) {
-    unsigned mach = i;
-    vector<Job> π(I.n + 1);
-    iota(π.begin(), π.end(), 0);
-    sort(π.begin() + 1, π.end(), [&](Job j1, Job j2) { return value[idx[{mach, j1 - 1, j2 - 1}]] > 0.5; });
-    for (unsigned j = 0u; j != I.n + 1; ++j)
-      S.π[i + 1][j] = π[j];
+    // jobs without an operation on machine i go last
+    π.assign(K.begin() + koff[i], K.begin() + koff[i + 1]);
+    sort(π.begin(), π.end(), [&](unsigned j1, unsigned j2) { return before(value, i, j1, j2); });
+    for (unsigned j = 0u; j != I.n; ++j)
+      if (pos[i][j] == none)
+        π.push_back(j);
+    for (unsigned k = 0u; k != I.n; ++k)
+      S.π[i + 1][k + 1] = π[k] + 1;
   }
   S.of = solver.getObjValue();
 
@@ -172,7 +265,7 @@ NPSolution MPFSMO::getSolution(IloCplex solver) {
 
 ModelStat MPFSMO::getStatistics() const { return mstat; }
 
-pair<NPSolution, IloAlgorithm::Status> MPFSMO::solve(const PSolution &S) {
+pair<NPSolution, IloAlgorithm::Status> MPFSMO::solve(const PSolution &S, SharedSolution *shared) {
   IloCplex solver(model);
   if (m.exportModel)
     solver.exportModel("model.lp");
@@ -180,6 +273,8 @@ pair<NPSolution, IloAlgorithm::Status> MPFSMO::solve(const PSolution &S) {
   setupSolver(solver, m);
   if (S.isValid())
     setSolution(solver, S);
+  if (shared)
+    solver.use(IloCplex::Callback(new (env) HeuristicInjector(env, *this, *shared)));
   solver.solve();
   IloAlgorithm::Status status = solver.getStatus();
   if (status == IloAlgorithm::Feasible || status == IloAlgorithm::Optimal)
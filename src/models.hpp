@@ -7,10 +7,11 @@
  */
 #pragma once
 
+#include <cassert>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <string>
-#include <tuple>
 
 #include <ilcplex/ilocplex.h>
 ILOSTLBEGIN
@@ -18,14 +19,28 @@ ILOSTLBEGIN
 #include "instance.hpp"
 #include "solution.hpp"
 
-void setupSolver(IloCplex solver);
 string to_string(IloAlgorithm::Status status);
 
 struct ModelOptions {
   bool exportModel;
   unsigned timelimit;
+  unsigned threads; // of CPLEX
 
-  ModelOptions() : timelimit(30) {}
+  ModelOptions() : timelimit(30), threads(1) {}
+};
+
+void setupSolver(IloCplex solver, const ModelOptions &m);
+
+// latest solution of a concurrent heuristic, passed to CPLEX from a heuristic callback
+struct SharedSolution {
+  std::mutex mx;
+  NPSolution S;
+  bool fresh;
+
+  SharedSolution(const Instance &I) : S(I), fresh(false) {}
+
+  void offer(const NPSolution &);
+  bool take(NPSolution &);
 };
 
 struct ModelStat {
@@ -33,6 +48,8 @@ struct ModelStat {
   std::string to_string() { return fmt::format("{} {} {}", rows, cols, nnz); }
 };
 
+// Disjunctive model with one binary x per machine and unordered pair of jobs that both have an operation on it, x=1 iff the
+// first job of the pair comes first. Variables are indexed arithmetically.
 struct MPFSMO {
   const Instance &I;
   IloEnv env;
@@ -42,22 +59,45 @@ struct MPFSMO {
   ModelOptions m;
   ModelStat mstat;
 
-  map<tuple<unsigned, unsigned, unsigned>, unsigned> idx;
+  Matrix<unsigned> pos;   // index of job j among the jobs with an operation on machine i, or `none`
+  vector<unsigned> nk;    // number of jobs with an operation on machine i
+  vector<unsigned> xoff;  // index of the first x of machine i
+  vector<unsigned> K;     // jobs with an operation on machine i (0-based), from koff[i] on
+  vector<unsigned> koff;  // index of the first job of machine i in `K`, koff[m] = |K|
   unsigned idx_c;
 
+  static constexpr unsigned none = ~0u;
+
   IloNumVarArray C, x;
+  IloNumVarArray vars; // C, then x
+
+  MPFSMO(const Instance &I, const ModelOptions &m) : I(I), model(env), obj(IloAdd(model, IloMinimize(env))), m(m), C(env), x(env), vars(env) {}
+  void addVars(Time);
+  void addCompletion();
 
-  MPFSMO(const Instance &I, const ModelOptions &m) : I(I), model(env), obj(IloAdd(model, IloMinimize(env))), m(m), C(env), x(env) {}
-  void addVars();
-  void addCompletion(Time = infinite_time);
-  void addPrecedences();
+  // index of the completion time of job `j` on machine `i`, both 0-based
+  unsigned ci(unsigned i, unsigned j) const { return i * I.n + j; }
+  // index of x for jobs with local indices a<b on machine i
+  unsigned xi(unsigned i, unsigned a, unsigned b) const {
+    assert(a < b && b < nk[i]);
+    return xoff[i] + a * nk[i] - a * (a + 1) / 2 + (b - a - 1);
+  }
+  // does job `j1` precede `j2` on machine `i` in `v`; both 0-based with operations on `i`
+  bool before(const IloNumArray &v, unsigned i, unsigned j1, unsigned j2) const {
+    const unsigned a = pos[i][j1], b = pos[i][j2];
+    return a < b ? v[xi(i, a, b)] > 0.5 : v[xi(i, b, a)] < 0.5;
+  }
 
+  // build the model for solutions of flowtime at most the given upper bound, `infinite_time` if none
   void build(Time);
 
+  // values of `vars` for `S` in `v`, which has their size; returns the objective value
+  double values(const NPSolution &S, IloNumArray &v) const;
   void setSolution(IloCplex, const PSolution &);
   void setSolution(IloCplex, const NPSolution &);
   NPSolution getSolution(IloCplex);
   ModelStat getStatistics() const;
 
-  std::pair<NPSolution, IloAlgorithm::Status> solve(const PSolution &);
+  // solve from the MIP start `S`, taking further solutions from `shared` if given
+  std::pair<NPSolution, IloAlgorithm::Status> solve(const PSolution &S, SharedSolution *shared = nullptr);
 };
@@ -9,14 +9,20 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <sstream>
 namespace fs = std::filesystem;
 using namespace std;
 
+#include "alloc.hpp"
+#include "bounds.hpp"
+#include "campaign.hpp"
 #include "helpers.hpp"
 #include "heuristics.hpp"
 #include "instance.hpp"
 #include "logging.hpp"
 #include "options.hpp"
+#include "profile.hpp"
 #include "random.hpp"
 #include "solution.hpp"
 
@@ -28,7 +34,18 @@ struct PFSOptions : public standardOptions {
   string psolution, npsolution;
   bool flowtime;
   bool npfs;
+  bool npsset;
+  bool lbstop;
+  unsigned buffer;
+  bool buffertie;
+  bool metrics;
+  bool npiga;
+  unsigned threads, ithreads;
   string solution, wpsolution;
+  string trace;
+  unsigned tracesize;
+  string campaign, results;
+  unsigned workers;
 
   PFSOptions() : timelimit(60) {}
 };
@@ -40,62 +57,62 @@ void add_results(vector<Time> &v, const pair<Time, Time> &tt) {
   v.push_back(tt.second);
 }
 
-int main(int argc, char *argv[]) {
-  run::start.reset();
-
-  IGAOptions iopt;
-  std_description desc("Options", opt);
-
-  desc.add_options()("timelimit", po::value<double>(&opt.timelimit)->default_value(0.0), "Time limit for heuristics (seconds; default 5ms/op, negative for none).")("iterlimit", po::value<int>(&opt.iterlimit)->default_value(0.0), "Iteration limit for heuristics (default 1.5×10⁵/n, negative for none).")("iterfactor", po::value<double>(&opt.iterfactor)->default_value(1.0), "Multiplier for default iteration limit (which has been calibrated for about 5ms/op)")("flowtime", po::bool_switch(&opt.flowtime)->default_value(false), "Make flowtime the primary objective.")("npfs", po::bool_switch(&opt.npfs)->default_value(false), "Apply NPFS optimizations.");
-
-  po::options_description iga("IGA options", get_terminal_width());
-  iga.add_options()("alpha", po::value<double>(&iopt.alpha)->default_value(0.234375), "Alpha.")("dc", po::value<unsigned>(&iopt.dc)->default_value(8), "D&C jobs.");
-
-  po::options_description out("Output options", get_terminal_width());
-  out.add_options()("psolution", po::value<string>(&opt.wpsolution)->default_value("/dev/null"), "File to write permutation solution to.")("solution", po::value<string>(&opt.solution)->default_value("/dev/null"), "File to write last solution to.");
-
-  desc.add(iga).add(out);
-
-  po::positional_options_description pod;
-  pod.add("instance", 1);
-
-  po::variables_map vm;
-  po::store(po::command_line_parser(argc, argv).options(desc).positional(pod).run(), vm);
-  po::notify(vm);
-
-  if (vm.count("help") || !vm.count("instance")) {
-    if (!vm.count("instance"))
-      fmt::print("No instance given.\n\n");
-    cout << desc << endl;
-    return 0;
-  }
-  opt.seed = setupRandom(opt.seed);
-
-  string iname = canonical_name(fs::path(opt.instance).filename());
-  ifstream ins(opt.instance);
-  if (ins.fail()) {
-    fmt::print(cerr, "Failed to open {}\n", opt.instance);
-    return 1;
-  }
-  Instance I(ins);
-  ins.close();
+// outcome of solving one instance
+struct Report {
+  unsigned dc;
+  double timelimit;
+  int iterlimit;
+  vector<Result> results;
+  vector<Time> npsset;
+  unsigned steps_shift, steps_iga, steps_shift_np;
+  unsigned long allocs_iga;
+  double time;
+  double tphase[4];        // time of construction, local search, IGA, and NP local search
+  unsigned long insertions; // jobs inserted
+  Bounds lb;
+  unsigned buffer;          // peak number of waiting jobs of the NP solution
+  unsigned npsbuffer;       // same, for the NPS-set decoding of the permutation
+  double jri;               // job reordering index of the NP solution
+  bool failed = false;      // a solution file could not be written
+};
 
-  vprint(1, "Instance with {} jobs and {} machines, missing operations rate {}.\n", I.n, I.m, I.r);
+Report solve(const Instance &I, IGAOptions iopt, PFSOptions opt) {
+  Report rep;
   if (opt.timelimit == 0.0)
     opt.timelimit = double(I.n * I.m * 5) / 1000;
   if (opt.iterlimit == 0)
     opt.iterlimit = max(1.0, opt.iterfactor * double(150000) / I.n);
   iopt.dc = min(iopt.dc, (8 * I.n + 9) / 10);
   vprint(1, "Timelimit {:.12f}, iteration limit {}, dc {}.\n", opt.timelimit, opt.iterlimit, iopt.dc);
+  rep.dc = iopt.dc;
+  rep.timelimit = opt.timelimit;
+  rep.iterlimit = opt.iterlimit;
+  rep.lb = lower_bounds(I);
+  vprint(1, "Lower bounds {}.\n", rep.lb.to_string());
 
+  ThreadPool pool(opt.ithreads);
+  Trace trace(opt.trace != "" ? opt.tracesize : 0);
   EPSolution S(I);
+  if (opt.ithreads > 1)
+    S.pool = &pool;
+  if (opt.trace != "")
+    S.trace = &trace;
   if (opt.flowtime)
     S.of_makespan = !opt.flowtime;
+  S.of_npsset = opt.npsset;
+  if (opt.npsset)
+    S.buffer = opt.buffer;
 
-  vprint(1, "Optimizing for {}.\n", opt.flowtime ? "flowtime" : "makespan");
+  vprint(1, "Optimizing for {}{}.\n", opt.flowtime ? "flowtime" : "makespan", opt.npsset ? " of the NPS-set decoding" : "");
 
-  vector<Result> results;
-  vector<Time> npsset;
+  auto &results = rep.results;
+  auto &npsset = rep.npsset;
+
+  double tphase = run::elapsed();
+  auto end_phase = [&](unsigned p) {
+    rep.tphase[p] = run::elapsed() - tphase;
+    tphase = run::elapsed();
+  };
 
   S.totalTimeOrder();
   S.clear();
@@ -108,8 +125,10 @@ int main(int argc, char *argv[]) {
   vprint(1, "{}\n", results.back().to_string());
 
   add_results(npsset, S.evaluateNPSset(I));
+  end_phase(0);
 
-  unsigned steps_shift = S.shift_ls();
+  rep.steps_shift = S.shift_ls();
+  end_phase(1);
   results.push_back(S.getResultPO());
   vprint(1, "Local search {} ", results.back().to_string());
   results.push_back(S.getResultSO());
@@ -119,7 +138,13 @@ int main(int argc, char *argv[]) {
   iopt.T = iopt.alpha * pavg / 10;
   iopt.timelimit = opt.timelimit - run::elapsed();
   iopt.iterlimit = opt.iterlimit;
-  unsigned steps_iga = S.iga(iopt);
+  if (opt.lbstop)
+    iopt.lb = S.of_makespan ? rep.lb.ms : rep.lb.ft;
+  rep.steps_iga = 0;
+  if (!opt.npiga)
+    rep.steps_iga = opt.threads > 1 ? parallel_iga(S, iopt, opt.threads, opt.seed) : S.iga(iopt);
+  rep.allocs_iga = S.allocs;
+  end_phase(2);
   results.push_back(S.getResultPO());
   vprint(1, "IGA {} ", results.back().to_string());
   results.push_back(S.getResultSO());
@@ -130,7 +155,8 @@ int main(int argc, char *argv[]) {
     ofstream sol(opt.wpsolution);
     if (sol.fail()) {
       fmt::print(cerr, "Failed to open {}\n", opt.wpsolution);
-      return 1;
+      rep.failed = true;
+      return rep;
     }
     fmt::print(sol, "# {}\n", S.to_string());
     S.write(sol);
@@ -138,34 +164,174 @@ int main(int argc, char *argv[]) {
   }
 
   add_results(npsset, S.evaluateNPSset(I));
+  if (opt.npsset && opt.buffer > 0)
+    rep.npsbuffer = S.nps_bufferspace();
   PSolution Sf{I, S.so.π};
   add_results(npsset, Sf.evaluateNPSset(I));
 
-  unsigned steps_shift_np = 0;
+  rep.steps_shift_np = 0;
   ENPSolution N(I, S);
-  if (opt.npfs) {
-    steps_shift_np = N.shift_ls();
+  N.trace = S.trace;
+  N.buffer = opt.buffer;
+  N.tie_buffer = opt.buffertie;
+  N.metrics = opt.metrics;
+  if (opt.npfs || opt.npiga) {
+    rep.steps_shift_np = N.shift_ls();
+    if (opt.npiga)
+      rep.steps_iga = N.iga(iopt);
     results.push_back(N.getResultPO());
-    vprint(1, "Local search NP {}\n", results.back().to_string());
+    vprint(1, "{} NP {}\n", opt.npiga ? "IGA" : "Local search", results.back().to_string());
   } else
     results.push_back({0, 0, 0});
-
-  fmt::print("PARAM {} {} {}\n", iopt.dc, opt.timelimit, opt.iterlimit);
-  fmt::print("INFO {} ", iname);
-  for (auto res : results)
-    fmt::print("{} ", res.to_string());
-  fmt::print("\n");
-  fmt::print("STAT {} {} {}\n", steps_shift, steps_iga, run::elapsed());
-  fmt::print("NSTAT {}\n", steps_shift_np);
-  fmt::print("NPSSET {}\n", fmt::join(npsset.begin(), npsset.end(), " "));
+  end_phase(3);
+  if (opt.metrics) {
+    N.update_metrics();
+    rep.buffer = N.peak_buffer();
+    rep.jri = N.jri();
+    assert(rep.jri == N.computeJRI(I));
+  } else if (opt.buffer > 0)
+    rep.buffer = N.bufferspace();
+  assert(!(opt.buffer > 0 || opt.metrics) || rep.buffer == N.computeBufferspace(I));
+  rep.time = run::elapsed();
+  rep.insertions = S.insertions + N.insertions;
 
   if (opt.solution != "/dev/null") {
     ofstream sol(opt.solution);
     if (sol.fail()) {
       fmt::print(cerr, "Failed to open {}\n", opt.solution);
-      return 1;
+      rep.failed = true;
+      return rep;
     }
     N.write(sol);
     sol.close();
   }
+
+  if (opt.trace != "")
+    trace.write(opt.trace);
+  return rep;
+}
+
+// CSV columns: instance key as in `data`, the results of the INFO line, the STAT and NSTAT counters, and the NPSSET values
+const string csv_header = "d,n,m,i,"
+                          "con.ms,con.ft,con.t,con.so.ms,con.so.ft,con.so.t,ls.ms,ls.ft,ls.t,ls.so.ms,ls.so.ft,ls.so.t,"
+                          "iga.ms,iga.ft,iga.t,iga.so.ms,iga.so.ft,iga.so.t,npls.ms,npls.ft,npls.t,"
+                          "steps.ls,steps.iga,time,steps.npls,"
+                          "con.nps.ms,con.nps.ft,iga.nps.ms,iga.nps.ft,iga.so.nps.ms,iga.so.nps.ft";
+
+string csv_row(const string &iname, const Instance &I, const Report &rep) {
+  istringstream in(iname);
+  vector<string> key{istream_iterator<string>(in), istream_iterator<string>()};
+  string row;
+  if (key.size() == 4)
+    row = fmt::format("{},{},{},{}", key[0], stoi(key[1]), stoi(key[2]), stoi(key[3]));
+  else
+    row = fmt::format("{},{},{},{}", I.r, I.n, I.m, iname);
+  for (auto res : rep.results)
+    row += fmt::format(",{},{},{}", res.ms, res.ft, res.tfound);
+  row += fmt::format(",{},{},{},{}", rep.steps_shift, rep.steps_iga, rep.time, rep.steps_shift_np);
+  for (auto v : rep.npsset)
+    row += fmt::format(",{}", v);
+  return row;
+}
+
+bool read_instance(const string &fname, Instance &I) {
+  if (Instance::is_binary(fname)) {
+    if (!I.read_binary(fname)) {
+      fmt::print(cerr, "Failed to read {}\n", fname);
+      return false;
+    }
+    return true;
+  }
+  ifstream ins(fname);
+  if (ins.fail()) {
+    fmt::print(cerr, "Failed to open {}\n", fname);
+    return false;
+  }
+  I.read_hn(ins);
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  run::start.reset();
+
+  IGAOptions iopt;
+  std_description desc("Options", opt);
+
+  desc.add_options()("timelimit", po::value<double>(&opt.timelimit)->default_value(0.0), "Time limit for heuristics (seconds; default 5ms/op, negative for none).")("iterlimit", po::value<int>(&opt.iterlimit)->default_value(0.0), "Iteration limit for heuristics (default 1.5×10⁵/n, negative for none).")("iterfactor", po::value<double>(&opt.iterfactor)->default_value(1.0), "Multiplier for default iteration limit (which has been calibrated for about 5ms/op)")("flowtime", po::bool_switch(&opt.flowtime)->default_value(false), "Make flowtime the primary objective.")("npfs", po::bool_switch(&opt.npfs)->default_value(false), "Apply NPFS optimizations.")("npsset", po::bool_switch(&opt.npsset)->default_value(false), "Optimize the objective of the NPS-set decoding of the permutation.")("lbstop", po::bool_switch(&opt.lbstop)->default_value(false), "Stop the IGA once its solution meets the lower bound.")("buffer", po::value<unsigned>(&opt.buffer)->default_value(0), "Limit on the jobs waiting between machines in the NP local search and the NPS-set decoding (0 for none).")("buffertie", po::bool_switch(&opt.buffertie)->default_value(false), "Break ties among NP moves by the jobs waiting between machines.")("metrics", po::bool_switch(&opt.metrics)->default_value(false), "Maintain the buffer space and JRI of the NP solution during the local search and report them.")("npiga", po::bool_switch(&opt.npiga)->default_value(false), "Replace the IGA by an IGA on the machine sequences, after the NP local search.");
+
+  po::options_description iga("IGA options", get_terminal_width());
+  iga.add_options()("alpha", po::value<double>(&iopt.alpha)->default_value(0.234375), "Alpha.")("dc", po::value<unsigned>(&iopt.dc)->default_value(8), "D&C jobs.")("threads", po::value<unsigned>(&opt.threads)->default_value(1), "Number of parallel IGA walks sharing the incumbent.")("restart", po::value<unsigned>(&iopt.restart)->default_value(50), "Iterations without improvement before a parallel walk restarts from the shared incumbent.")("ithreads", po::value<unsigned>(&opt.ithreads)->default_value(1), "Number of threads scanning insertion positions for the makespan (for large instances).");
+
+  po::options_description out("Output options", get_terminal_width());
+  out.add_options()("psolution", po::value<string>(&opt.wpsolution)->default_value("/dev/null"), "File to write permutation solution to.")("solution", po::value<string>(&opt.solution)->default_value("/dev/null"), "File to write last solution to.")("trace", po::value<string>(&opt.trace)->default_value(""), "File to write the trace of the search to (JSON if it ends in .json, otherwise CSV).")("tracesize", po::value<unsigned>(&opt.tracesize)->default_value(1u << 16), "Number of most recent trace events kept.");
+
+  po::options_description camp("Campaign options", get_terminal_width());
+  camp.add_options()("campaign", po::value<string>(&opt.campaign)->default_value(""), "Solve all instances of a directory, a glob pattern, or a manifest listing one instance per line.")("results", po::value<string>(&opt.results)->default_value("results.csv"), "CSV file the campaign appends to; instances already in it are skipped.")("workers", po::value<unsigned>(&opt.workers)->default_value(1), "Number of instances solved in parallel.");
+
+  desc.add(iga).add(out).add(camp);
+
+  po::positional_options_description pod;
+  pod.add("instance", 1);
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).options(desc).positional(pod).run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help") || (!vm.count("instance") && opt.campaign == "")) {
+    if (!vm.count("instance"))
+      fmt::print("No instance given.\n\n");
+    cout << desc << endl;
+    return 0;
+  }
+  opt.seed = setupRandom(opt.seed);
+
+  if (opt.campaign != "") {
+    PFSOptions copt = opt;
+    copt.wpsolution = copt.solution = "/dev/null";
+    copt.trace = "";
+    return run_campaign(campaign_instances(opt.campaign), opt.results, csv_header, opt.workers, [&](const string &fname, string &row) {
+      run::start.reset();
+      setupRandom(copt.seed);
+      Instance I;
+      if (!read_instance(fname, I))
+        return false;
+      Report rep = solve(I, iopt, copt);
+      if (rep.failed)
+        return false;
+      row = csv_row(canonical_name(fs::path(fname).filename()), I, rep);
+      return true;
+    });
+  }
+
+  string iname = canonical_name(fs::path(opt.instance).filename());
+  Instance I;
+  if (!read_instance(opt.instance, I))
+    return 1;
+
+  vprint(1, "Instance with {} jobs and {} machines, missing operations rate {}.\n", I.n, I.m, I.r);
+  profile::reset();
+  Report rep = solve(I, iopt, opt);
+  if (rep.failed)
+    return 1;
+
+  fmt::print("PARAM {} {} {}\n", rep.dc, rep.timelimit, rep.iterlimit);
+  fmt::print("INFO {} ", iname);
+  for (auto res : rep.results)
+    fmt::print("{} ", res.to_string());
+  fmt::print("\n");
+  fmt::print("STAT {} {} {}\n", rep.steps_shift, rep.steps_iga, rep.time);
+  fmt::print("NSTAT {}\n", rep.steps_shift_np);
+  fmt::print("BOUND {}\n", rep.lb.to_string());
+  if (opt.buffer > 0) {
+    fmt::print("BUFFER {} {} {}\n", opt.buffer, rep.buffer, rep.buffer <= opt.buffer ? "feasible" : "infeasible");
+    if (opt.npsset)
+      fmt::print("NPSBUFFER {} {} {}\n", opt.buffer, rep.npsbuffer, rep.npsbuffer <= opt.buffer ? "feasible" : "infeasible");
+  }
+  if (opt.metrics)
+    fmt::print("METRICS {} {:.6f}\n", rep.buffer, rep.jri);
+  if (profile::enabled)
+    fmt::print("PROFILE {:.6f} {:.6f} {:.6f} {:.6f} {} {:.1f} {} {:.1f} {}\n", rep.tphase[0], rep.tphase[1], rep.tphase[2], rep.tphase[3], rep.insertions, rep.insertions / rep.time, profile::evaluations.load(), profile::evaluations / rep.time, profile::to_string());
+  if (alloc::counting)
+    fmt::print("ALLOCS {} {}\n", rep.steps_iga, rep.allocs_iga);
+  fmt::print("NPSSET {}\n", fmt::join(rep.npsset.begin(), rep.npsset.end(), " "));
 }
@@ -0,0 +1,75 @@
+/**
+ * \file pool.hpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ *
+ * Fork-join thread pool.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// `run(f)` calls f(t) for t=0,...,size()-1 in parallel, with t=0 on the calling thread, and returns when all calls finished
+struct ThreadPool {
+  std::vector<std::thread> workers;
+  std::mutex mx;
+  std::condition_variable start, done;
+  const std::function<void(unsigned)> *f;
+  unsigned generation, pending;
+  bool quit;
+
+  ThreadPool(unsigned nt) : f(nullptr), generation(0), pending(0), quit(false) {
+    for (unsigned t = 1; t < nt; ++t)
+      workers.emplace_back([this, t] { work(t); });
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mx);
+      quit = true;
+    }
+    start.notify_all();
+    for (auto &w : workers)
+      w.join();
+  }
+
+  unsigned size() const { return workers.size() + 1; }
+
+  void run(const std::function<void(unsigned)> &g) {
+    {
+      std::lock_guard<std::mutex> lock(mx);
+      f = &g;
+      pending = workers.size();
+      generation++;
+    }
+    start.notify_all();
+    g(0);
+    std::unique_lock<std::mutex> lock(mx);
+    done.wait(lock, [this] { return pending == 0; });
+    f = nullptr;
+  }
+
+  void work(unsigned t) {
+    unsigned seen = 0;
+    for (;;) {
+      const std::function<void(unsigned)> *g;
+      {
+        std::unique_lock<std::mutex> lock(mx);
+        start.wait(lock, [&] { return quit || generation != seen; });
+        if (quit)
+          return;
+        seen = generation;
+        g = f;
+      }
+      (*g)(t);
+      {
+        std::lock_guard<std::mutex> lock(mx);
+        if (--pending == 0)
+          done.notify_one();
+      }
+    }
+  }
+};
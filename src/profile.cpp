@@ -0,0 +1,29 @@
+/**
+ * \file profile.cpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ */
+#include "profile.hpp"
+
+using namespace std;
+
+#include "logging.hpp"
+
+namespace profile {
+Counter kernel[nkernels];
+atomic<unsigned long> evaluations{0};
+
+static const char *const name[nkernels] = {"insert_all_ms", "insert_all_ft", "insert_all_nps", "insert_all_np", "remove", "remove_np", "compute_ms_ft_mo", "evaluateNPSset", "computeJRI"};
+
+void reset() {
+  for (auto &c : kernel)
+    c.calls = c.ns = 0;
+  evaluations = 0;
+}
+
+string to_string() {
+  string s;
+  for (unsigned k = 0; k != nkernels; ++k)
+    s += fmt::format("{}{} {} {:.6f}", k ? " " : "", name[k], kernel[k].calls.load(), kernel[k].ns.load() / 1e9);
+  return s;
+}
+} // namespace profile
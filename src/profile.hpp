@@ -0,0 +1,53 @@
+/**
+ * \file profile.hpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ *
+ * Counters and timers of the scheduling kernels. They are compiled in with NPFSMO_PROFILE; otherwise the macros expand to
+ * nothing.
+ */
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "timer.hpp"
+
+namespace profile {
+#ifdef NPFSMO_PROFILE
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+enum Kernel { insert_all_ms, insert_all_ft, insert_all_nps, insert_all_np, remove, remove_np, compute_ms_ft_mo, evaluateNPSset, computeJRI, nkernels };
+
+struct Counter {
+  std::atomic<unsigned long> calls{0}, ns{0};
+};
+
+extern Counter kernel[nkernels];
+extern std::atomic<unsigned long> evaluations; // objective values of candidate solutions computed, complete or incremental
+
+// account the lifetime of the scope as one call of kernel `k`
+struct Scope {
+  Kernel k;
+  timer t;
+  Scope(Kernel k) : k(k) {}
+  ~Scope() {
+    kernel[k].calls.fetch_add(1, std::memory_order_relaxed);
+    kernel[k].ns.fetch_add((unsigned long)(t.elapsed() * 1e9), std::memory_order_relaxed);
+  }
+};
+
+void reset();
+// calls and seconds of each kernel as `name calls seconds`
+std::string to_string();
+} // namespace profile
+
+#ifdef NPFSMO_PROFILE
+#define PROFILE_SCOPE(k) profile::Scope profile_scope_(profile::k)
+#define PROFILE_EVALUATIONS(c) profile::evaluations.fetch_add(c, std::memory_order_relaxed)
+#else
+#define PROFILE_SCOPE(k)
+#define PROFILE_EVALUATIONS(c)
+#endif
@@ -9,7 +9,7 @@
 #include <fstream>
 using namespace std;
 
-mt19937 rng;
+thread_local mt19937 rng;
 
 unsigned setupRandom(unsigned seed) {
   if (seed == 0) {
@@ -6,11 +6,11 @@
  */
 #pragma once
 
+#include <algorithm>
 #include <random>
-#include <set>
 #include <vector>
 
-extern std::mt19937 rng;
+extern thread_local std::mt19937 rng; // one generator per thread, seeded by `setupRandom`
 
 unsigned setupRandom(unsigned seed = 0);
 
@@ -19,12 +19,23 @@ inline double getRandom() {
   return U(rng);
 }
 
-inline std::vector<unsigned> sample_floyd(unsigned k, unsigned N) {
+// sorted sample of `k` from {0,...,N-1} into `S`; does not allocate if `S` has capacity for `k` elements
+inline void sample_floyd(unsigned k, unsigned N, std::vector<unsigned> &S) {
   std::uniform_int_distribution<> dis;
-  std::set<unsigned> S;
+  S.clear();
   for (unsigned u = N - k; u != N; u++) {
-    auto sample = dis(rng) % u;
-    S.insert(S.find(sample) == S.end() ? sample : u);
+    unsigned sample = dis(rng) % u;
+    auto p = std::lower_bound(S.begin(), S.end(), sample);
+    if (p != S.end() && *p == sample)
+      S.push_back(u); // u is larger than all samples so far
+    else
+      S.insert(p, sample);
   }
-  return std::vector<unsigned>(S.begin(), S.end());
+}
+
+inline std::vector<unsigned> sample_floyd(unsigned k, unsigned N) {
+  std::vector<unsigned> S;
+  S.reserve(k);
+  sample_floyd(k, N, S);
+  return S;
 }
@@ -13,6 +13,7 @@ using namespace std;
 using namespace boost;
 
 #include "holes.hpp"
+#include "profile.hpp"
 
 void PSolution::read(istream &in) {
   string line;
@@ -39,15 +40,15 @@ Result PSolution::getResult(const Instance &I) {
 }
 
 pair<Time, Time> PSolution::compute_ms_ft_mo(const Instance &I, vector<Time> &C) {
+  PROFILE_SCOPE(compute_ms_ft_mo);
+  PROFILE_EVALUATIONS(1);
   assert(I.n == n && I.m == m && C.size() == m + 1);
   Time ft = 0, ms = 0;
   fill(C.begin(), C.end(), 0);
   for (unsigned j = 1; j != fbegin; ++j) {
     Time Cj = 0;
-    const auto jb = π[j];
-    for (unsigned i = 1; i <= m; ++i)
-      if (I.p[jb][i] > 0)
-        C[i] = Cj = max(C[i], Cj) + I.p[jb][i];
+    for (auto [i, p] : I.operations(π[j]))
+      C[i] = Cj = max(C[i], Cj) + p;
     ft += Cj;
     ms = max(ms, Cj);
   }
@@ -97,29 +98,12 @@ bool PSolution::valid_permutation() const {
 }
 
 std::pair<Time, Time> PSolution::evaluateNPSset(const Instance &I, bool smallest) const {
-  vector<hlist> h(m);
-  Time ms = 0, ft = 0;
-
-  for (auto j = 1u; j <= n; ++j) {
-    Time Ct = 0;
-    for (auto i = 1u; i <= m; ++i) {
-      const auto p = I.p[π[j]][i];
-      if (p == 0)
-        continue;
-      auto e = smallest ? h[i - 1].smallest(p, Ct) : h[i - 1].earliest(p, Ct);
-      const auto s = e->start();
-      if (Ct <= s) {
-        h[i - 1].reduce(e, p);
-        Ct = s;
-      } else {
-        h[i - 1].cut(e, Ct, p);
-      }
-      Ct += p;
-    }
-    ms = max(ms, Ct);
-    ft += Ct;
-  }
-  return {ms, ft};
+  PROFILE_SCOPE(evaluateNPSset);
+  PROFILE_EVALUATIONS(1);
+  NPSState S(m);
+  for (auto j = 1u; j <= n; ++j)
+    S.add(I, π[j], smallest);
+  return {S.ms, S.ft};
 }
 
 void NPSolution::read(istream &in) {
@@ -150,6 +134,8 @@ void NPSolution::write(ostream &out) {
 }
 
 pair<Time, Time> NPSolution::compute_ms_ft_mo(const Instance &I, vector<Time> &C) {
+  PROFILE_SCOPE(compute_ms_ft_mo);
+  PROFILE_EVALUATIONS(1);
   assert(I.n == n && I.m == m && C.size() == m + 1);
   Time ms = 0;
   vector<Time> Cj(n + 1, 0);
@@ -157,8 +143,8 @@ pair<Time, Time> NPSolution::compute_ms_ft_mo(const Instance &I, vector<Time> &C
     Time Ci = 0;
     for (unsigned k = 1; k != fbegin; ++k) {
       const auto j = π[i][k];
-      if (I.p[j][i] > 0)
-        Ci = Cj[j] = max(Ci, Cj[j]) + I.p[j][i];
+      if (I.pm[i][j] > 0)
+        Ci = Cj[j] = max(Ci, Cj[j]) + I.pm[i][j];
     }
     ms = max(ms, Ci);
   }
@@ -166,6 +152,7 @@ pair<Time, Time> NPSolution::compute_ms_ft_mo(const Instance &I, vector<Time> &C
 }
 
 double NPSolution::computeJRI(const Instance &I) const {
+  PROFILE_SCOPE(computeJRI);
   multi_array<Time, 2> Cj(extents[m + 1][n + 1]);
   compute_completion_times(I, Cj);
 
@@ -193,7 +180,7 @@ double NPSolution::computeJRI(const Instance &I) const {
         continue;
 
       unsigned nji = k + 1;
-      while (nji <= n && I.p[π[i][nji]][i] == 0)
+      while (nji <= n && I.pm[i][π[i][nji]] == 0)
         nji++;
       if (nji > n) {
         buffer[nm].push_back({Cj[I.lastOperation(j)][j], j});
@@ -211,20 +198,29 @@ double NPSolution::computeJRI(const Instance &I) const {
       }
     }
 
+  Matrix<unsigned> ρ;
+  inverse(ρ);
   double jri = 0.0;
   for (unsigned i = 2; i <= m; ++i) {
-    sort(buffer[i].begin(), buffer[i].end(), [&](const Event &e, const Event &f) { return e.t < f.t || (e.t == f.t && jobIndex(i, e.j) < jobIndex(i, f.j)); });
+    sort(buffer[i].begin(), buffer[i].end(), [&](const Event &e, const Event &f) { return e.t < f.t || (e.t == f.t && ρ[i][e.j] < ρ[i][f.j]); });
     std::vector<Job> bv, πv;
     for (auto be : buffer[i])
       bv.push_back(be.j);
     for (unsigned k = 1; k <= n; ++k)
-      if (I.p[π[i][k]][i] != 0)
+      if (I.pm[i][π[i][k]] != 0)
         πv.push_back(π[i][k]);
     jri += kendall_tau(bv, πv);
   }
   return jri / (n * (m - 1));
 }
 
+void NPSolution::inverse(Matrix<unsigned> &ρ) const {
+  ρ.resize(m + 1, n + 1);
+  for (unsigned i = 1; i <= m; ++i)
+    for (unsigned k = 1; k <= n; ++k)
+      ρ[i][π[i][k]] = k;
+}
+
 unsigned NPSolution::computeBufferspace(const Instance &I) const {
   multi_array<Time, 2> Cj(extents[m + 1][n + 1]);
   compute_completion_times(I, Cj);
@@ -233,7 +229,7 @@ unsigned NPSolution::computeBufferspace(const Instance &I) const {
     Time t;
     unsigned i;
     int d;
-    bool operator<(const Event &e) const { return t < e.t; }
+    bool operator<(const Event &e) const { return t < e.t || (t == e.t && d < e.d); }
   };
   std::vector<Event> e;
 
@@ -248,7 +244,7 @@ unsigned NPSolution::computeBufferspace(const Instance &I) const {
         continue;
 
       unsigned nji = k + 1;
-      while (nji <= n && I.p[π[i][nji]][i] == 0)
+      while (nji <= n && I.pm[i][π[i][nji]] == 0)
         nji++;
       if (nji > n)
         continue;
@@ -262,19 +258,15 @@ unsigned NPSolution::computeBufferspace(const Instance &I) const {
       }
     }
 
+  // jobs leave before others arrive at the same time
   unsigned mbs = 0;
   std::sort(e.begin(), e.end());
   unsigned bs = 0;
-  Time lt = 0;
   for (auto ev : e) {
     assert(int(bs) + ev.d >= 0);
     bs += ev.d;
-    if (ev.t != lt) {
-      mbs = std::max(mbs, bs);
-      lt = ev.t;
-    }
+    mbs = std::max(mbs, bs);
   }
-  mbs = std::max(mbs, bs);
   return mbs;
 }
 
@@ -289,8 +281,8 @@ void NPSolution::compute_completion_times(const Instance &I, multi_array<Time, 2
       const auto j = π[i][k];
       Cj[i][k] = Cjb[j];
       Ci[i][k] = Ci[i][k - 1];
-      if (I.p[j][i] > 0) {
-        Ci[i][k] = Cj[i][k] = Cjb[j] = max(Ci[i][k], Cj[i][k]) + I.p[j][i];
+      if (I.pm[i][j] > 0) {
+        Ci[i][k] = Cj[i][k] = Cjb[j] = max(Ci[i][k], Cj[i][k]) + I.pm[i][j];
         last[j] = i;
       }
     }
@@ -14,6 +14,7 @@
 #include "fmt/format.h"
 
 #include "instance.hpp"
+#include "matrix.hpp"
 
 // result for reporting
 struct Result {
@@ -28,19 +29,6 @@ struct Solution {
   unsigned n, m;
   Time of; // primary objective (makespan or flowtime)
 
-  Solution(Solution &&other) { this->swap(other); }
-
-  Solution(const Solution &other) {
-    n = other.n;
-    m = other.m;
-    of = other.of;
-  }
-
-  Solution &operator=(Solution other) {
-    this->swap(other);
-    return *this;
-  }
-
   void swap(Solution &other) {
     using std::swap;
     swap(n, other.n);
@@ -63,18 +51,6 @@ struct PSolution : public Solution {
     assert(valid_permutation());
   }
 
-  PSolution(PSolution &&other) { this->swap(other); }
-
-  PSolution(const PSolution &other) : Base(other) {
-    π = other.π;
-    fbegin = other.fbegin;
-  }
-
-  PSolution &operator=(PSolution other) {
-    this->swap(other);
-    return *this;
-  }
-
   void swap(PSolution &other) {
     Base::swap(other);
     using std::swap;
@@ -113,40 +89,25 @@ struct PSolution : public Solution {
 struct NPSolution : public Solution {
   typedef Solution Base;
 
-  boost::multi_array<Job, 2> π; // permutations of jobs, i=1:m, j=1:n
-  unsigned fbegin;              // by convention: fbegin,... all stored straight.
+  Matrix<Job> π;   // permutations of jobs, i=1:m, j=1:n
+  unsigned fbegin; // by convention: fbegin,... all stored straight.
 
-  NPSolution(const Instance &I) : Base(I), π(boost::extents[I.m + 1][I.n + 1]), fbegin(I.n + 1) {
+  NPSolution(const Instance &I) : Base(I), π(I.m + 1, I.n + 1), fbegin(I.n + 1) {
     for (auto i = 1u; i <= I.m; ++i)
       for (auto j = 1u; j <= I.n; ++j)
         π[i][j] = j;
   }
 
-  NPSolution(const Instance &I, const PSolution &P) : Base(Solution(P)), π(boost::extents[I.m + 1][I.n + 1]), fbegin(I.n + 1) {
+  NPSolution(const Instance &I, const PSolution &P) : Base(P), π(I.m + 1, I.n + 1), fbegin(I.n + 1) {
     for (auto i = 1u; i <= I.m; ++i)
       for (auto j = 1u; j <= I.n; ++j)
         π[i][j] = P.π[j];
   }
 
-  NPSolution(NPSolution &&other) { this->swap(other); }
-
-  NPSolution(const NPSolution &other) : Base(other) {
-    π.resize(boost::extents[other.π.shape()[0]][other.π.shape()[1]]);
-    π = other.π;
-    fbegin = other.fbegin;
-  }
-
-  NPSolution &operator=(NPSolution other) {
-    this->swap(other);
-    return *this;
-  }
-
   void swap(NPSolution &other) {
     Base::swap(other);
-    using std::swap;
-    π.resize(boost::extents[other.π.shape()[0]][other.π.shape()[1]]);
-    swap(π, other.π);
-    swap(fbegin, other.fbegin);
+    π.swap(other.π);
+    std::swap(fbegin, other.fbegin);
   }
 
   void read(std::istream &);
@@ -164,6 +125,9 @@ struct NPSolution : public Solution {
 
   unsigned computeBufferspace(const Instance &I) const;
   double computeJRI(const Instance &I) const;
+  // positions of the jobs, ρ[i][π[i][k]]=k
+  void inverse(Matrix<unsigned> &ρ) const;
+  // position of job `j` on machine `i`; use `inverse` for many queries
   unsigned jobIndex(unsigned i, Job j) const {
     unsigned k = 1;
     while (k <= n && π[i][k] != j)
@@ -0,0 +1,45 @@
+/**
+ * \file trace.cpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ */
+#include "trace.hpp"
+
+#include <filesystem>
+#include <fstream>
+namespace fs = std::filesystem;
+using namespace std;
+
+#include "logging.hpp"
+
+// call `f` on the kept events in the order they were recorded
+template <typename F> void Trace::events(F f) const {
+  const unsigned long cap = ev.size(), kb = recorded > cap ? recorded - cap : 0;
+  for (auto k = kb; k != recorded; ++k)
+    f(ev[k % cap], k + 1 == recorded);
+}
+
+void Trace::write_csv(ostream &out) const {
+  fmt::print(out, "time,phase,iteration,of,best,evaluations,accepted\n");
+  events([&](const TraceEvent &e, bool) { fmt::print(out, "{:.6f},{},{},{},{},{},{}\n", e.t, e.phase, e.it, e.of, e.best, e.evals, int(e.accepted)); });
+}
+
+void Trace::write_json(ostream &out) const {
+  fmt::print(out, "{{\n  \"recorded\": {},\n  \"events\": [\n", recorded);
+  events([&](const TraceEvent &e, bool last) {
+    fmt::print(out, "    {{\"time\": {:.6f}, \"phase\": \"{}\", \"iteration\": {}, \"of\": {}, \"best\": {}, \"evaluations\": {}, \"accepted\": {}}}{}\n", e.t, e.phase, e.it, e.of, e.best, e.evals, e.accepted, last ? "" : ",");
+  });
+  fmt::print(out, "  ]\n}}\n");
+}
+
+bool Trace::write(const string &fname) const {
+  ofstream out(fname);
+  if (out.fail()) {
+    fmt::print(cerr, "Failed to open {}\n", fname);
+    return false;
+  }
+  if (fs::path(fname).extension() == ".json")
+    write_json(out);
+  else
+    write_csv(out);
+  return true;
+}
@@ -0,0 +1,48 @@
+/**
+ * \file trace.hpp
+ *   \author Marcus Ritt <marcus.ritt@inf.ufrgs.br>
+ *
+ * Trace of the search progress, for anytime profiles and time-to-target analyses.
+ */
+#pragma once
+
+#include <algorithm>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "instance.hpp"
+
+// one step of a search: phase 'I' (IGA iteration), 'S' (shift local search), 'N' (non-permutation shift local search) or
+// 'J' (non-permutation IGA iteration)
+struct TraceEvent {
+  double t;
+  char phase;
+  unsigned it;         // iteration or step of the phase
+  Time of, best;       // current and best objective value
+  unsigned long evals; // jobs inserted so far
+  bool accepted;
+};
+
+// the last `capacity` events in a ring buffer; solvers record only if a trace is attached, so a disabled trace costs a test per step
+struct Trace {
+  std::vector<TraceEvent> ev;
+  unsigned long recorded; // events recorded so far, the last `ev.size()` of them are kept
+  std::mutex mx;          // parallel IGA walks share the trace
+
+  Trace(unsigned capacity) : ev(std::max(capacity, 1u)), recorded(0) {}
+
+  void record(const TraceEvent &e) {
+    std::lock_guard<std::mutex> lock(mx);
+    ev[recorded++ % ev.size()] = e;
+  }
+
+  void write_csv(std::ostream &) const;
+  void write_json(std::ostream &) const;
+  // write as JSON if `fname` ends in .json, otherwise as CSV
+  bool write(const std::string &fname) const;
+
+private:
+  template <typename F> void events(F f) const;
+};